@@ -9,6 +9,11 @@
 #include <vector>
 #include <string>
 #include <type_traits>
+#include <string_view>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
 
 using namespace std;
 
@@ -39,6 +44,8 @@ class Edge{
 public:
     T weight;   // Weight of the  Edge
     bool isEmpty;
+    int from = -1;  // Index of the source vertex
+    int to = -1;    // Index of the target vertex
 
     Edge(){
         this->isEmpty = true;
@@ -53,6 +60,67 @@ public:
     }
 };
 
+/**
+ * Class NeighbourRange
+ * View over the non-empty cells of one row or column of an adjacency
+ * matrix, yielding the index of the neighbour and the edge without allocating
+ * @tparam T Type of the weight
+ */
+template<typename T>
+class NeighbourRange{
+    const vector< vector<Edge<T>*> >& edges;   // Adjacency matrix
+    int line;                                   // Index of the row or column
+    bool incoming;                              // Whether the view walks a column
+
+public:
+    class iterator{
+        const NeighbourRange* range;
+        int index;
+
+        void skip(){
+            while (index < range->edges.size() && range->cell(index)->isEmpty)
+                index++;
+        }
+
+    public:
+        iterator(const NeighbourRange* range, int index) : range(range), index(index){
+            skip();
+        }
+        pair<int, Edge<T>*> operator*() const{
+            return {index, range->cell(index)};
+        }
+        iterator& operator++(){
+            index++;
+            skip();
+            return *this;
+        }
+        bool operator!=(const iterator& other) const{
+            return index != other.index;
+        }
+    };
+
+    /**
+     * Constructor with parameters
+     * @param edges Adjacency matrix
+     * @param line Index of the row or column
+     * @param incoming Whether to walk the column instead of the row
+     */
+    NeighbourRange(const vector< vector<Edge<T>*> >& edges, int line, bool incoming)
+        : edges(edges), line(line), incoming(incoming){}
+
+    Edge<T>* cell(int i) const{
+        return incoming ? edges[i][line] : edges[line][i];
+    }
+
+    iterator begin() const{
+        return iterator(this, 0);
+    }
+
+    iterator end() const{
+        return iterator(this, edges.size());
+    }
+};
+
 
 /**
  * An abstract class of Graph ADT
@@ -155,13 +223,45 @@ public:
         return -1;
     }
 
+    /**
+     * Method that returns a view over the edges going from a vertex
+     * @param index Index of the vertex
+     * @return Pairs of the target index and the edge
+     */
+    NeighbourRange<E> outNeighbours(int index){
+        return NeighbourRange<E>(edges, index, false);
+    }
+
+    /**
+     * Method that returns a view over the edges going to a vertex
+     * @param index Index of the vertex
+     * @return Pairs of the source index and the edge
+     */
+    NeighbourRange<E> inNeighbours(int index){
+        return NeighbourRange<E>(edges, index, true);
+    }
+
+    /**
+     * Method that records the position of an edge in the matrix
+     * @param edge Edge
+     * @param from Index of the source vertex
+     * @param to Index of the target vertex
+     * @return The same edge
+     */
+    static Edge<E>* place(Edge<E>* edge, int from, int to){
+        edge->from = from;
+        edge->to = to;
+        return edge;
+    }
+
     /**
      * Overriding of the Method that adds a vertex with value to the graph
      * @param value Title of the vertex
      * @return Reference to the created vertex object
      */
     Vertex<V>* addVertex(V value) override{
-        int index = getIndex(new Vertex<V>(value));
+        Vertex<V> probe(value);
+        int index = getIndex(&probe);
         if (index != -1){
             return vertices[index];
         }
@@ -170,14 +270,15 @@ public:
         auto newVertex = new Vertex<V>(value);
         vertices[vertices.size() - 1] = newVertex;
 
+        int last = vertices.size() - 1;
         vector<Edge<E>*> v;
         for (int i = 0; i < vertices.size(); i++){
-            v.push_back(new Edge<E>);
+            v.push_back(place(new Edge<E>(), last, i));
         }
         edges.push_back(v);
 
         for (int i = 0; i < vertices.size() - 1; i++)
-            edges[i].push_back(new Edge<E>);
+            edges[i].push_back(place(new Edge<E>(), i, last));
 
         return newVertex;
     }
@@ -196,6 +297,10 @@ public:
             edges[i].erase(edges[i].begin() + index);
         }
 
+        for (int i = 0; i < vertices.size(); i++)
+            for (int j = (i < index ? index : 0); j < vertices.size(); j++)
+                place(edges[i][j], i, j);
+
     }
 
     /**
@@ -219,7 +324,7 @@ public:
             if (count == 2)
                 break;
         }
-        edges[fromVertexID][toVertexID] = new Edge<E>(weight);
+        edges[fromVertexID][toVertexID] = place(new Edge<E>(weight), fromVertexID, toVertexID);
 
         return edges[fromVertexID][toVertexID];
     }
@@ -241,10 +346,8 @@ public:
      */
     vector<Edge<E>*> edgesFrom(Vertex<V>* v) override{
         vector<Edge<E>*> result;
-        int index = getIndex(v);
-        for (auto edge : edges[index])
-            if (!edge->isEmpty)
-                result.push_back(edge);
+        for (auto neighbour : outNeighbours(getIndex(v)))
+            result.push_back(neighbour.second);
         return result;
     }
 
@@ -256,10 +359,8 @@ public:
      */
     vector<Edge<E>*> edgesTo(Vertex<V>* v) override{
         vector<Edge<E>*> result;
-        int index = getIndex(v);
-        for (auto edge : edges)
-            if (!edge[index]->isEmpty)
-                result.push_back(edge[index]);
+        for (auto neighbour : inNeighbours(getIndex(v)))
+            result.push_back(neighbour.second);
         return result;
     }
 
@@ -285,9 +386,9 @@ public:
      * @return Reference to an edge object
      */
     Edge<E>* findEdge(V from_value, V to_value) override{
-        auto from = new Vertex<V>(from_value);
-        auto to = new Vertex<V>(to_value);
-        return edges[getIndex(from)][getIndex(to)];
+        Vertex<V> from(from_value);
+        Vertex<V> to(to_value);
+        return edges[getIndex(&from)][getIndex(&to)];
     }
 
     /**
@@ -307,48 +408,169 @@ public:
 
 };
 
+/**
+ * Class SymbolTable
+ * Interns vertex titles into dense 32-bit identifiers, keeping every
+ * title once in an arena together with its precomputed hash
+ */
+class SymbolTable{
+public:
+    static const uint32_t NONE = UINT32_MAX;   // Identifier of an unknown title
+
+private:
+    static constexpr size_t CHUNK = 1 << 16;    // Size of an arena chunk in bytes
+
+    /**
+     * Interned title
+     */
+    struct Symbol{
+        const char* data;   // Characters in the arena
+        uint32_t length;    // Number of characters
+        uint32_t hash;      // Hash of the characters
+    };
+
+    vector< unique_ptr<char[]> > chunks;        // Arena holding the characters
+    size_t used = CHUNK;                        // Bytes used in the last chunk
+    vector<Symbol> symbols;                     // Titles by identifier
+    vector<uint32_t> slots;                     // Open addressing table of identifier + 1
+
+    static uint32_t hashOf(string_view title){
+        uint32_t hash = 2166136261u;
+        for (char c : title){
+            hash ^= (unsigned char) c;
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    /**
+     * Method that finds the slot of a title
+     * @param title Title
+     * @param hash Hash of the title
+     * @return Index of the slot holding the title or of the empty slot where it belongs
+     */
+    size_t probe(string_view title, uint32_t hash) const{
+        size_t mask = slots.size() - 1;
+        for (size_t i = hash & mask; ; i = (i + 1) & mask){
+            if (slots[i] == 0)
+                return i;
+            const Symbol& symbol = symbols[slots[i] - 1];
+            if (symbol.hash == hash && string_view(symbol.data, symbol.length) == title)
+                return i;
+        }
+    }
+
+    const char* store(string_view title){
+        if (used + title.size() > CHUNK){
+            chunks.emplace_back(new char[max(CHUNK, title.size())]);
+            used = 0;
+        }
+        char* data = chunks.back().get() + used;
+        memcpy(data, title.data(), title.size());
+        used += title.size();
+        return data;
+    }
+
+    void grow(){
+        vector<uint32_t> larger(max<size_t>(16, slots.size() * 2), 0);
+        slots.swap(larger);
+        for (uint32_t id = 0; id < symbols.size(); id++){
+            size_t mask = slots.size() - 1, i = symbols[id].hash & mask;
+            while (slots[i] != 0)
+                i = (i + 1) & mask;
+            slots[i] = id + 1;
+        }
+    }
+
+public:
+    /**
+     * Method that returns the identifier of a title, adding it if needed
+     * @param title Title
+     * @return Identifier
+     */
+    uint32_t intern(string_view title){
+        if (2 * (symbols.size() + 1) > slots.size())
+            grow();
+        uint32_t hash = hashOf(title);
+        size_t slot = probe(title, hash);
+        if (slots[slot] == 0){
+            symbols.push_back({store(title), (uint32_t) title.size(), hash});
+            slots[slot] = symbols.size();
+        }
+        return slots[slot] - 1;
+    }
+
+    /**
+     * Method that returns the identifier of a title without adding it
+     * @param title Title
+     * @return Identifier, NONE if the title was never interned
+     */
+    uint32_t find(string_view title) const{
+        if (slots.empty())
+            return NONE;
+        return slots[probe(title, hashOf(title))] - 1;
+    }
+
+    /**
+     * Method that returns the title of an identifier
+     * @param id Identifier
+     * @return Title
+     */
+    string_view title(uint32_t id) const{
+        return string_view(symbols[id].data, symbols[id].length);
+    }
+
+    /**
+     * Method that returns the number of interned titles
+     * @return Number of titles
+     */
+    size_t size() const{
+        return symbols.size();
+    }
+};
+
 /**
  * Method that solves current problem
  */
 void solve(){
-    typedef string V;
+    typedef uint32_t V;
     typedef int E;
 
     AdjacencyMatrixGraph<V, E> graph;
+    SymbolTable symbols;    // Titles of the vertices, the graph only sees their identifiers
 
-    string cmd;
+    string cmd, from, to;
     int weight = 0;
     while (cin >> cmd){
 
         if (cmd == "ADD_VERTEX"){
-            string title;
-            cin >> title;
-            graph.addVertex(title);
+            cin >> from;
+            graph.addVertex(symbols.intern(from));
         }
         else if (cmd == "REMOVE_VERTEX"){
-            string title;
-            cin >> title;
-            auto vertex = new Vertex<V>(title);
-            graph.removeVertex(vertex);
+            cin >> from;
+            Vertex<V> vertex(symbols.find(from));
+            if (graph.getIndex(&vertex) != -1)
+                graph.removeVertex(&vertex);
         }
         else if (cmd == "ADD_EDGE"){
-            string from, to;
             cin >> from >> to >> weight;
-            auto fromVertex = new Vertex<V>(from);
-            auto toVertex = new Vertex<V>(to);
-            graph.addEdge(fromVertex, toVertex, weight);
+            Vertex<V> fromVertex(symbols.intern(from));
+            Vertex<V> toVertex(symbols.intern(to));
+            graph.addEdge(&fromVertex, &toVertex, weight);
         }
         else if (cmd == "REMOVE_EDGE"){
-            string from, to;
             cin >> from >> to;
-            graph.removeEdge(graph.findEdge(from, to));
+            Vertex<V> fromVertex(symbols.find(from));
+            Vertex<V> toVertex(symbols.find(to));
+            if (graph.hasEdge(&fromVertex, &toVertex))
+                graph.removeEdge(graph.findEdge(fromVertex.title, toVertex.title));
         }
         else if (cmd == "HAS_EDGE"){
-            string from, to;
             cin >> from >> to;
-            auto fromVertex = new Vertex<V>(from);
-            auto toVertex = new Vertex<V>(to);
-            if (graph.hasEdge(fromVertex, toVertex))
+            Vertex<V> fromVertex(symbols.find(from));
+            Vertex<V> toVertex(symbols.find(to));
+            if (graph.hasEdge(&fromVertex, &toVertex))
                 cout << "TRUE" << endl;
             else
                 cout << "FALSE" << endl;
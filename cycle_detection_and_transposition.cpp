@@ -9,7 +9,36 @@
 #include <vector>
 #include <string>
 #include <type_traits>
+#include <string_view>
+#include <memory>
+#include <cstdint>
 #include <cstring>
+#include <algorithm>
+#include <queue>
+#include <tuple>
+#include <unordered_map>
+#include <map>
+#include <functional>
+#include <fstream>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <csignal>
+#include <cerrno>
+#include <random>
+#include <sstream>
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <deque>
 
 using namespace std;
 
@@ -40,6 +69,8 @@ class Edge{
 public:
     T weight;   // Weight of the  Edge
     bool isEmpty;
+    int from = -1;  // Index of the source vertex
+    int to = -1;    // Index of the target vertex
 
     Edge(){
         this->isEmpty = true;
@@ -54,6 +85,67 @@ public:
     }
 };
 
+/**
+ * Class NeighbourRange
+ * View over the non-empty cells of one row or column of an adjacency
+ * matrix, yielding the index of the neighbour and the edge without allocating
+ * @tparam T Type of the weight
+ */
+template<typename T>
+class NeighbourRange{
+    const vector< vector<Edge<T>*> >& edges;   // Adjacency matrix
+    int line;                                   // Index of the row or column
+    bool incoming;                              // Whether the view walks a column
+
+public:
+    class iterator{
+        const NeighbourRange* range;
+        int index;
+
+        void skip(){
+            while (index < range->edges.size() && range->cell(index)->isEmpty)
+                index++;
+        }
+
+    public:
+        iterator(const NeighbourRange* range, int index) : range(range), index(index){
+            skip();
+        }
+        pair<int, Edge<T>*> operator*() const{
+            return {index, range->cell(index)};
+        }
+        iterator& operator++(){
+            index++;
+            skip();
+            return *this;
+        }
+        bool operator!=(const iterator& other) const{
+            return index != other.index;
+        }
+    };
+
+    /**
+     * Constructor with parameters
+     * @param edges Adjacency matrix
+     * @param line Index of the row or column
+     * @param incoming Whether to walk the column instead of the row
+     */
+    NeighbourRange(const vector< vector<Edge<T>*> >& edges, int line, bool incoming)
+        : edges(edges), line(line), incoming(incoming){}
+
+    Edge<T>* cell(int i) const{
+        return incoming ? edges[i][line] : edges[line][i];
+    }
+
+    iterator begin() const{
+        return iterator(this, 0);
+    }
+
+    iterator end() const{
+        return iterator(this, edges.size());
+    }
+};
+
 
 /**
  * An abstract class of Graph ADT
@@ -131,6 +223,406 @@ public:
 };
 
 
+/**
+ * Class GraphBatch
+ * Mutations staged to be applied to a graph in one pass
+ * @tparam V Type of the title
+ * @tparam E Type of the weight
+ */
+template<typename V, typename E>
+class GraphBatch{
+public:
+    enum Type {ADD_VERTEX, REMOVE_VERTEX, ADD_EDGE, REMOVE_EDGE, TRANSPOSE};
+
+    /**
+     * Staged mutation
+     */
+    struct Operation{
+        Type type;
+        V from;     // Title of the vertex or of the source of the edge
+        V to;       // Title of the target of the edge
+        E weight;   // Weight of the added edge
+    };
+
+    vector<Operation> operations;   // Mutations in the order they were staged
+
+    void addVertex(V value){
+        operations.push_back({ADD_VERTEX, value, value, E()});
+    }
+
+    void removeVertex(V value){
+        operations.push_back({REMOVE_VERTEX, value, value, E()});
+    }
+
+    void addEdge(V from, V to, E weight){
+        operations.push_back({ADD_EDGE, from, to, weight});
+    }
+
+    void removeEdge(V from, V to){
+        operations.push_back({REMOVE_EDGE, from, to, E()});
+    }
+
+    void transpose(){
+        operations.push_back({TRANSPOSE, V(), V(), E()});
+    }
+
+    bool empty(){
+        return operations.empty();
+    }
+
+    void clear(){
+        operations.clear();
+    }
+};
+
+/**
+ * Struct NoProfile
+ * Profiling policy of plain queries, its hooks are empty and compile away
+ */
+struct NoProfile{
+    static const bool enabled = false;
+
+    void settle(){}
+    void scan(){}
+    void skip(){}
+    void push(size_t){}
+    void pop(size_t){}
+    void reach(int){}
+    void allocate(size_t){}
+    void phase(const char*){}
+};
+
+static NoProfile noProfile;             // Profile of the queries run without EXPLAIN
+
+/**
+ * Class QueryProfile
+ * Profiling policy of EXPLAIN, counting the work of one query and timing its phases
+ */
+class QueryProfile{
+public:
+    static const bool enabled = true;
+
+    long long settled = 0;              // Vertices settled or entered
+    long long scanned = 0;              // Edges examined
+    long long filtered = 0;             // Edges skipped by a filter of the query
+    long long pushes = 0;               // Pushes to the queue or the stack
+    long long pops = 0;                 // Pops from the queue or the stack
+    int depth = 0;                      // Longest depth-first path
+    long long allocated = 0;            // Bytes of the working arrays
+
+private:
+    typedef chrono::steady_clock Clock;
+
+    /**
+     * Timed part of the query
+     */
+    struct Phase{
+        string name;
+        Clock::time_point start;
+        double milliseconds;
+    };
+
+    vector<Phase> phases;
+    long long pending = 0;              // Bytes held by the queue or the stack
+    long long peak = 0;                 // Largest value of pending
+
+    static Clock::time_point origin(){
+        static Clock::time_point start = Clock::now();
+        return start;
+    }
+
+    static string quoted(const string& text){
+        string result = "\"";
+        for (char c : text){
+            if (c == '"' || c == '\\')
+                result += '\\';
+            result += c;
+        }
+        return result + "\"";
+    }
+
+public:
+    QueryProfile(){
+        origin();
+    }
+
+    void settle(){
+        settled++;
+    }
+
+    void scan(){
+        scanned++;
+    }
+
+    void skip(){
+        filtered++;
+    }
+
+    void push(size_t bytes){
+        pushes++;
+        pending += bytes;
+        peak = max(peak, pending);
+    }
+
+    void pop(size_t bytes){
+        pops++;
+        pending -= bytes;
+    }
+
+    void reach(int length){
+        depth = max(depth, length);
+    }
+
+    void allocate(size_t bytes){
+        allocated += bytes;
+    }
+
+    /**
+     * Method that ends the current phase and starts the next one
+     * @param name Name of the next phase, nullptr to only end the current one
+     */
+    void phase(const char* name){
+        Clock::time_point now = Clock::now();
+        if (!phases.empty() && phases.back().milliseconds < 0)
+            phases.back().milliseconds = chrono::duration<double, milli>(now - phases.back().start).count();
+        if (name)
+            phases.push_back({name, now, -1});
+    }
+
+    /**
+     * Method that prints the counters and the time of every phase
+     * @param out Output stream
+     */
+    void report(ostream& out){
+        phase(nullptr);
+        out << "EXPLAIN settled " << settled << " scanned " << scanned << " filtered " << filtered
+            << " pushes " << pushes << " pops " << pops << " depth " << depth << " bytes " << allocated + peak << endl;
+        for (auto& part : phases)
+            out << "PHASE " << part.name << " " << part.milliseconds << endl;
+    }
+
+    /**
+     * Method that appends the query and its phases as Chrome trace events
+     * @param events Events in JSON
+     * @param query Text of the query
+     */
+    void trace(vector<string>& events, const string& query){
+        phase(nullptr);
+        auto micros = [](Clock::time_point at){
+            return chrono::duration_cast<chrono::microseconds>(at - origin()).count();
+        };
+        if (phases.empty()) return;
+        long long start = micros(phases.front().start);
+        long long total = micros(phases.back().start) + (long long) (phases.back().milliseconds * 1000) - start;
+
+        ostringstream event;
+        event << "{\"name\":" << quoted(query) << ",\"cat\":\"query\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":" << start
+              << ",\"dur\":" << total << ",\"args\":{\"settled\":" << settled << ",\"scanned\":" << scanned
+              << ",\"filtered\":" << filtered << ",\"pushes\":" << pushes << ",\"pops\":" << pops
+              << ",\"depth\":" << depth << ",\"bytes\":" << allocated + peak << "}}";
+        events.push_back(event.str());
+        for (auto& part : phases){
+            event.str("");
+            event << "{\"name\":" << quoted(part.name) << ",\"cat\":\"phase\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":"
+                  << micros(part.start) << ",\"dur\":" << (long long) (part.milliseconds * 1000) << "}";
+            events.push_back(event.str());
+        }
+    }
+
+    /**
+     * Method that writes trace events as a file for chrome://tracing
+     * @param path Path of the file
+     * @param events Events in JSON
+     * @return Whether the file was written
+     */
+    static bool writeTrace(const string& path, const vector<string>& events){
+        ofstream file(path, ios::trunc);
+        file << "{\"traceEvents\":[";
+        for (size_t i = 0; i < events.size(); i++)
+            file << (i ? ",\n" : "\n") << events[i];
+        file << "\n]}" << endl;
+        return (bool) file;
+    }
+};
+
+/**
+ * Class EdgeFilter
+ * Cuckoo filter over the edges, keyed by the titles of their endpoints. Every
+ * key keeps a 16-bit fingerprint in one of two buckets of four slots, and both
+ * buckets lie in the same 64-byte block, so a lookup reads one cache line.
+ * Keys can be deleted as long as only inserted keys are
+ */
+class EdgeFilter{
+    static const int SLOTS = 4;         // Fingerprints per bucket
+    static const int BUCKETS = 8;       // Buckets per block
+    static const int KICKS = 128;       // Evictions tried before an insertion fails
+
+    /**
+     * Cache line of buckets, a zero fingerprint marks a free slot
+     */
+    struct alignas(64) Block{
+        uint16_t slots[BUCKETS][SLOTS];
+    };
+
+    vector<Block> blocks;
+    size_t mask = 0;                    // Number of blocks minus one
+    size_t count = 0;                   // Keys stored
+    uint64_t seed = 0x2545F4914F6CDD1DULL;  // State of the eviction choices
+
+    static uint64_t mix(uint64_t x){
+        x ^= x >> 33;
+        x *= 0xFF51AFD7ED558CCDULL;
+        x ^= x >> 33;
+        x *= 0xC4CEB9FE1A85EC53ULL;
+        return x ^ (x >> 33);
+    }
+
+    /**
+     * Offset between the two buckets of a fingerprint, never zero
+     */
+    static int offset(uint16_t fingerprint){
+        return 1 + fingerprint % (BUCKETS - 1);
+    }
+
+    /**
+     * Method that places a key's block, bucket and fingerprint
+     */
+    void locate(uint64_t key, Block*& block, int& bucket, uint16_t& fingerprint){
+        uint64_t hash = mix(key);
+        block = &blocks[hash & mask];
+        bucket = (hash >> 40) % BUCKETS;
+        fingerprint = hash >> 48;
+        if (fingerprint == 0)
+            fingerprint = 1;
+    }
+
+    static bool place(Block& block, int bucket, uint16_t fingerprint){
+        for (uint16_t& slot : block.slots[bucket])
+            if (slot == 0){
+                slot = fingerprint;
+                return true;
+            }
+        return false;
+    }
+
+public:
+    bool enabled = false;               // Whether the graph keeps the filter
+    atomic<long long> lookups{0};       // Queries asked
+    atomic<long long> rejected{0};      // Queries answered without the matrix
+    atomic<long long> falsePositives{0};    // Queries passed on for absent edges
+
+    /**
+     * Method that combines the hashes of the endpoints of an edge into a key
+     */
+    static uint64_t key(size_t from, size_t to){
+        return mix(from) * 31 + to;
+    }
+
+    /**
+     * Method that empties the filter, sized for a number of keys at half load
+     * @param expected Expected number of keys
+     */
+    void reset(size_t expected){
+        size_t size = 1;
+        while (size * BUCKETS * SLOTS < 2 * expected)
+            size *= 2;
+        blocks.assign(size, Block());
+        mask = size - 1;
+        count = 0;
+    }
+
+    /**
+     * Method that adds a key
+     * @param key Key
+     * @return False if no slot was found, the filter then misses a key and must be rebuilt larger
+     */
+    bool insert(uint64_t key){
+        Block* block;
+        int bucket;
+        uint16_t fingerprint;
+        locate(key, block, bucket, fingerprint);
+        count++;
+        if (place(*block, bucket, fingerprint) || place(*block, bucket ^ offset(fingerprint), fingerprint))
+            return true;
+
+        // Move fingerprints to their other bucket until one finds room
+        for (int kick = 0; kick < KICKS; kick++){
+            seed ^= seed << 13;
+            seed ^= seed >> 7;
+            seed ^= seed << 17;
+            if (seed & SLOTS)
+                bucket ^= offset(fingerprint);
+            swap(fingerprint, block->slots[bucket][seed % SLOTS]);
+            bucket ^= offset(fingerprint);
+            if (place(*block, bucket, fingerprint))
+                return true;
+        }
+        return false;
+    }
+
+    /**
+     * Method that removes one copy of a key
+     * @param key Key that was inserted
+     */
+    void erase(uint64_t key){
+        Block* block;
+        int bucket;
+        uint16_t fingerprint;
+        locate(key, block, bucket, fingerprint);
+        for (int b : {bucket, bucket ^ offset(fingerprint)})
+            for (uint16_t& slot : block->slots[b])
+                if (slot == fingerprint){
+                    slot = 0;
+                    count--;
+                    return;
+                }
+    }
+
+    /**
+     * Method that determines whether a key may be present
+     * @param key Key
+     * @return False if the key is certainly absent
+     */
+    bool contains(uint64_t key){
+        Block* block;
+        int bucket;
+        uint16_t fingerprint;
+        locate(key, block, bucket, fingerprint);
+        lookups.fetch_add(1, memory_order_relaxed);
+        for (int b : {bucket, bucket ^ offset(fingerprint)})
+            for (uint16_t slot : block->slots[b])
+                if (slot == fingerprint)
+                    return true;
+        rejected.fetch_add(1, memory_order_relaxed);
+        return false;
+    }
+
+    size_t size() const{
+        return count;
+    }
+
+    size_t bytes() const{
+        return blocks.size() * sizeof(Block);
+    }
+
+    /**
+     * Method that returns the share of the slots in use
+     */
+    double load() const{
+        return blocks.empty() ? 0 : (double) count / (blocks.size() * BUCKETS * SLOTS);
+    }
+
+    /**
+     * Method that returns the expected false positive rate, a lookup comparing
+     * the fingerprints in use in two buckets
+     */
+    double expectedFalsePositives() const{
+        return 2 * SLOTS * load() / 65535;
+    }
+};
+
+template<typename V, typename E, typename Profile = NoProfile>
+class AcyclicitySearch;
 
 template<typename V,typename E>
 class AdjacencyMatrixGraph: public Graph<V,E>{
@@ -138,22 +630,231 @@ public:
     vector<Vertex<V>*> vertices;        // vector of vertices
     vector< vector<Edge<E>*> > edges;   // vector of vectors of edges
 
+private:
+    unordered_map<V, int> positions;    // Index of every vertex by title
+    bool positionsStale = false;        // Whether positions must be rebuilt
+    vector<int> outDegrees, inDegrees;  // Edges going from and to every vertex
+    vector<int> outHistogram;           // Number of vertices with every out-degree, no trailing zeros
+    vector<int> inHistogram;            // Number of vertices with every in-degree, no trailing zeros
+    size_t edgeTotal = 0;               // Number of edges
+    E weightTotal = E();                // Sum of the weights of the edges
+
+    uint64_t edgeKey(int from, int to){
+        return EdgeFilter::key(hash<V>()(vertices[from]->title), hash<V>()(vertices[to]->title));
+    }
+
+    /**
+     * Method that moves a vertex to another bucket of a degree histogram
+     * @param histogram Histogram
+     * @param from Old degree, -1 for a new vertex
+     * @param to New degree, -1 for a removed vertex
+     */
+    static void shift(vector<int>& histogram, int from, int to){
+        if (from != -1)
+            histogram[from]--;
+        if (to != -1){
+            if (to >= histogram.size())
+                histogram.resize(to + 1, 0);
+            histogram[to]++;
+        }
+        while (!histogram.empty() && histogram.back() == 0)
+            histogram.pop_back();
+    }
+
+    /**
+     * Method that records that a cell of the matrix got an edge
+     * @param from Index of the source vertex
+     * @param to Index of the target vertex
+     */
+    void linked(int from, int to){
+        shift(outHistogram, outDegrees[from], outDegrees[from] + 1);
+        outDegrees[from]++;
+        shift(inHistogram, inDegrees[to], inDegrees[to] + 1);
+        inDegrees[to]++;
+        edgeTotal++;
+        weightTotal += edges[from][to]->weight;
+        if (filter.enabled && (filter.load() > 0.9 || !filter.insert(edgeKey(from, to))))
+            rebuildFilter();
+    }
+
+    /**
+     * Method that records that a cell of the matrix is losing its edge
+     * @param from Index of the source vertex
+     * @param to Index of the target vertex
+     */
+    void unlinked(int from, int to){
+        shift(outHistogram, outDegrees[from], outDegrees[from] - 1);
+        outDegrees[from]--;
+        shift(inHistogram, inDegrees[to], inDegrees[to] - 1);
+        inDegrees[to]--;
+        edgeTotal--;
+        weightTotal -= edges[from][to]->weight;
+        if (filter.enabled)
+            filter.erase(edgeKey(from, to));
+    }
+
+    /**
+     * Method that writes an edge into a cell of the matrix, replacing the one there
+     * @param from Index of the source vertex
+     * @param to Index of the target vertex
+     * @param weight Weight of the edge
+     * @return The new edge
+     */
+    Edge<E>* setEdge(int from, int to, E weight){
+        Edge<E>* previous = edges[from][to];
+        edges[from][to] = place(new Edge<E>(weight), from, to);
+        if (previous->isEmpty)
+            linked(from, to);
+        else
+            weightTotal += weight - previous->weight;
+        return edges[from][to];
+    }
+
+    /**
+     * Method that appends an isolated vertex to the degree arrays
+     */
+    void appendDegrees(){
+        outDegrees.push_back(0);
+        inDegrees.push_back(0);
+        shift(outHistogram, -1, 0);
+        shift(inHistogram, -1, 0);
+    }
+
+    /**
+     * Method that inserts every edge into an empty filter, doubling it until all fit
+     */
+    void rebuildFilter(){
+        size_t count = 0;
+        for (auto& row : edges)
+            for (auto edge : row)
+                count += !edge->isEmpty;
+        for (size_t expected = count; ; expected *= 2){
+            filter.reset(max<size_t>(expected, 1));
+            bool fits = true;
+            for (int i = 0; i < vertices.size() && fits; i++)
+                for (auto neighbour : outNeighbours(i))
+                    if (!(fits = filter.insert(edgeKey(i, neighbour.first))))
+                        break;
+            if (fits)
+                return;
+        }
+    }
+
 public:
+    EdgeFilter filter;                  // Filter of HAS_EDGE in front of the matrix, off by default
+
     /**
      * Default constructor
      */
     AdjacencyMatrixGraph() = default;
 
+    /**
+     * Method that rebuilds the index of the vertices by title if it is stale,
+     * after which lookups only read the graph and may run concurrently
+     */
+    void refreshPositions(){
+        if (!positionsStale) return;
+        positions.clear();
+        for (int i = 0; i < vertices.size(); i++)
+            positions[vertices[i]->title] = i;
+        positionsStale = false;
+    }
+
+    /**
+     * Method that turns the edge filter on or off, building it from the matrix
+     * @param enabled Whether to keep the filter
+     */
+    void useFilter(bool enabled){
+        filter.enabled = enabled;
+        if (enabled)
+            rebuildFilter();
+        else
+            filter.reset(0);
+    }
+
+    /**
+     * Method that returns the number of edges going from a vertex
+     * @param index Index of the vertex
+     * @return Out-degree
+     */
+    int outDegree(int index) const{
+        return outDegrees[index];
+    }
+
+    /**
+     * Method that returns the number of edges going to a vertex
+     * @param index Index of the vertex
+     * @return In-degree
+     */
+    int inDegree(int index) const{
+        return inDegrees[index];
+    }
+
+    /**
+     * Method that returns the number of edges
+     * @return Number of edges
+     */
+    size_t edgeCount() const{
+        return edgeTotal;
+    }
+
+    /**
+     * Method that returns the sum of the weights of the edges
+     * @return Total weight
+     */
+    E totalWeight() const{
+        return weightTotal;
+    }
+
+    /**
+     * Method that returns the number of vertices with every degree
+     * @param incoming Whether to count in-degrees rather than out-degrees
+     * @return Histogram indexed by degree, up to the largest one
+     */
+    const vector<int>& degreeHistogram(bool incoming) const{
+        return incoming ? inHistogram : outHistogram;
+    }
+
     /**
      * Method that determines the index of the Vertex v
      * @param v Vertex
      * @return Index
      */
     int getIndex(Vertex<V>* v){
-        for (int i = 0; i < vertices.size(); i++)
-            if (vertices[i]->title == v->title)
-                return i;
-        return -1;
+        refreshPositions();
+        auto position = positions.find(v->title);
+        return position == positions.end() ? -1 : position->second;
+    }
+
+    /**
+     * Method that returns a view over the edges going from a vertex
+     * @param index Index of the vertex
+     * @return Pairs of the target index and the edge
+     */
+    NeighbourRange<E> outNeighbours(int index){
+        return NeighbourRange<E>(edges, index, false);
+    }
+
+    /**
+     * Method that returns a view over the edges going to a vertex
+     * @param index Index of the vertex
+     * @return Pairs of the source index and the edge
+     */
+    NeighbourRange<E> inNeighbours(int index){
+        return NeighbourRange<E>(edges, index, true);
+    }
+
+    /**
+     * Method that records the position of an edge in the matrix
+     * @param edge Edge
+     * @param from Index of the source vertex
+     * @param to Index of the target vertex
+     * @return The same edge
+     */
+    static Edge<E>* place(Edge<E>* edge, int from, int to){
+        edge->from = from;
+        edge->to = to;
+        return edge;
     }
 
     /**
@@ -162,7 +863,8 @@ public:
      * @return Reference to the created vertex object
      */
     Vertex<V>* addVertex(V value) override{
-        int index = getIndex(new Vertex<V>(value));
+        Vertex<V> probe(value);
+        int index = getIndex(&probe);
         if (index != -1){
             return vertices[index];
         }
@@ -170,15 +872,18 @@ public:
         vertices.resize(vertices.size() + 1);
         auto newVertex = new Vertex<V>(value);
         vertices[vertices.size() - 1] = newVertex;
+        positions[value] = vertices.size() - 1;
 
+        int last = vertices.size() - 1;
         vector<Edge<E>*> v;
         for (int i = 0; i < vertices.size(); i++){
-            v.push_back(new Edge<E>());
+            v.push_back(place(new Edge<E>(), last, i));
         }
         edges.push_back(v);
 
         for (int i = 0; i < vertices.size() - 1; i++)
-            edges[i].push_back(new Edge<E>());
+            edges[i].push_back(place(new Edge<E>(), i, last));
+        appendDegrees();
 
         return newVertex;
     }
@@ -189,7 +894,17 @@ public:
      */
     void removeVertex(Vertex<V> *v) override{
         int index = getIndex(v);
+        for (auto neighbour : outNeighbours(index))
+            unlinked(index, neighbour.first);
+        for (auto neighbour : inNeighbours(index))
+            if (neighbour.first != index)
+                unlinked(neighbour.first, index);
         vertices.erase(vertices.begin() + index);
+        positionsStale = true;
+        shift(outHistogram, 0, -1);
+        shift(inHistogram, 0, -1);
+        outDegrees.erase(outDegrees.begin() + index);
+        inDegrees.erase(inDegrees.begin() + index);
 
         edges.erase(edges.begin() + index);
 
@@ -197,6 +912,10 @@ public:
             edges[i].erase(edges[i].begin() + index);
         }
 
+        for (int i = 0; i < vertices.size(); i++)
+            for (int j = (i < index ? index : 0); j < vertices.size(); j++)
+                place(edges[i][j], i, j);
+
     }
 
     /**
@@ -220,9 +939,7 @@ public:
             if (count == 2)
                 break;
         }
-        edges[fromVertexID][toVertexID] = new Edge<E>(weight);
-
-        return edges[fromVertexID][toVertexID];
+        return setEdge(fromVertexID, toVertexID, weight);
     }
 
     /**
@@ -230,6 +947,8 @@ public:
      * @param e Reference to an edge object
      */
     void removeEdge(Edge<E>* e) override{
+        if (!e->isEmpty)
+            unlinked(e->from, e->to);
         e->isEmpty = true;
         e->weight = 0;
     }
@@ -242,10 +961,8 @@ public:
      */
     vector<Edge<E>*> edgesFrom(Vertex<V>* v) override{
         vector<Edge<E>*> result;
-        int index = getIndex(v);
-        for (auto edge : edges[index])
-            if (!edge->isEmpty)
-                result.push_back(edge);
+        for (auto neighbour : outNeighbours(getIndex(v)))
+            result.push_back(neighbour.second);
         return result;
     }
 
@@ -257,10 +974,8 @@ public:
      */
     vector<Edge<E>*> edgesTo(Vertex<V>* v) override{
         vector<Edge<E>*> result;
-        int index = getIndex(v);
-        for (auto edge : edges)
-            if (!edge[index]->isEmpty)
-                result.push_back(edge[index]);
+        for (auto neighbour : inNeighbours(getIndex(v)))
+            result.push_back(neighbour.second);
         return result;
     }
 
@@ -286,9 +1001,9 @@ public:
      * @return Reference to an edge object
      */
     Edge<E>* findEdge(V from_value, V to_value) override{
-        auto from = new Vertex<V>(from_value);
-        auto to = new Vertex<V>(to_value);
-        return edges[getIndex(from)][getIndex(to)];
+        Vertex<V> from(from_value);
+        Vertex<V> to(to_value);
+        return edges[getIndex(&from)][getIndex(&to)];
     }
 
     /**
@@ -299,11 +1014,14 @@ public:
      * @return Boolean result
      */
     bool hasEdge(Vertex<V>* v, Vertex<V>* u) override{
+        if (filter.enabled && !filter.contains(EdgeFilter::key(hash<V>()(v->title), hash<V>()(u->title))))
+            return false;
         int x = getIndex(v);
-        if (x == -1) return false;
-        int y = getIndex(u);
-        if (y == -1) return false;
-        return edges[getIndex(v)][getIndex(u)]->isEmpty == false;
+        int y = x == -1 ? -1 : getIndex(u);
+        bool present = y != -1 && edges[x][y]->isEmpty == false;
+        if (filter.enabled && !present)
+            filter.falsePositives.fetch_add(1, memory_order_relaxed);
+        return present;
     }
 
     /**
@@ -314,162 +1032,3060 @@ public:
             for (int j = i + 1; j < vertices.size(); j++){
                 Edge<E>* temp;
                 temp = edges[i][j];
-                edges[i][j] = edges[j][i];
-                edges[j][i] = temp;
+                edges[i][j] = place(edges[j][i], i, j);
+                edges[j][i] = place(temp, j, i);
             }
+        outDegrees.swap(inDegrees);
+        outHistogram.swap(inHistogram);
+        if (filter.enabled)
+            rebuildFilter();
     }
 
-
     /**
-     * Method that determines whether graph has a cycle
-     * @param from Beginning vertex
-     * @param visited Vector of visited vertices
-     * @param stack Vector of vertices
-     * @return Whether graph is cyclic return vertex that forms a cycle
+     * Method that applies a batch of mutations with the same result as applying
+     * them one by one, resizing the matrix once and writing edges in row order;
+     * edges between vertices that are missing at that point are ignored
+     * @param batch Staged mutations, emptied afterwards
      */
-    Vertex<V>* cycleDFS(Vertex<V>* from, vector<Vertex<V>*>& visited, vector<Vertex<V>*>& stack){
-        visited.push_back(from);
-        stack.push_back(from);
-        for (Edge<E>* edge : edgesFrom(from)){
-            Vertex<V>* to;
-            for (int i = 0; i < vertices.size(); i++)
-                for (int j = 0; j < vertices.size(); j++)
-                    if (edge == edges[i][j]){
-                        to = vertices[j];
-
-                        bool temp = false;
-                        for (Vertex<V>* vertex: visited)
-                            if (to->title == vertex->title){
-                                temp = true;
-                                break;
-                            }
-
-                        if (!temp){
-                            Vertex<V>* result = cycleDFS(to, visited, stack);
-                            if (result != nullptr){
-                                return result;
-                            }
-                        }
-                        else
-                            for (Vertex<V>* vertex: stack)
-                                if (to->title == vertex->title)
-                                    return to;
-                    }
+    void apply(GraphBatch<V, E>& batch){
+        auto& operations = batch.operations;
+        for (int begin = 0; begin < operations.size(); ){
+            int end = begin;
+            while (end < operations.size() && operations[end].type != GraphBatch<V, E>::TRANSPOSE)
+                end++;
+            applySegment(operations, begin, end);
+            if (end < operations.size())
+                transpose();
+            begin = end + 1;
         }
-
-        stack.pop_back();
-
-        return nullptr;
+        batch.clear();
     }
 
+private:
     /**
-     * Method that determines whether graph is acyclic
-     * @param stack Order of the path
-     * @return True whether graph is acyclic
+     * Method that applies the vertex and edge mutations between two positions
+     * @param operations Staged mutations
+     * @param begin First position
+     * @param end Position after the last one
      */
-    bool isAcyclic(vector<Vertex<V>*>& stack){
-        vector<Vertex<V>*> visited = vector<Vertex<V>*>(0);
-
-        for(auto vertex: vertices){
-            Vertex<V>* from = vertex;
-            visited.clear();
-            stack.clear();
-            Vertex<V>* result = cycleDFS(from, visited, stack);
-
-            if (result != nullptr){
-                Vertex<V>* front = stack.front();
-                while (front!=result){
-                    stack.erase(stack.begin());
-                    front = stack.front();
-                }
-                return false;
+    void applySegment(vector<typename GraphBatch<V, E>::Operation>& operations, int begin, int end){
+        typedef GraphBatch<V, E> Batch;
+        unordered_map<V, bool> present;     // Presence of the vertices touched so far
+        unordered_map<V, int> removedAt;    // Position of the last removal of a vertex
+        vector<V> added;                    // Vertices to append, in order
+        vector<int> changes;                // Positions of the edge mutations that apply
+
+        auto isPresent = [&](V value){
+            auto staged = present.find(value);
+            if (staged != present.end())
+                return staged->second;
+            Vertex<V> probe(value);
+            return getIndex(&probe) != -1;
+        };
+
+        for (int k = begin; k < end; k++){
+            auto& operation = operations[k];
+            if (operation.type == Batch::ADD_VERTEX && !isPresent(operation.from)){
+                present[operation.from] = true;
+                added.push_back(operation.from);
+            }
+            else if (operation.type == Batch::REMOVE_VERTEX && isPresent(operation.from)){
+                present[operation.from] = false;
+                removedAt[operation.from] = k;
+                auto staged = find(added.begin(), added.end(), operation.from);
+                if (staged != added.end())
+                    added.erase(staged);
+            }
+            else if ((operation.type == Batch::ADD_EDGE || operation.type == Batch::REMOVE_EDGE)
+                     && isPresent(operation.from) && isPresent(operation.to)){
+                changes.push_back(k);
+            }
+        }
+
+        // Vertices removed at any point leave their old row and column
+        if (!removedAt.empty()){
+            int kept = 0;
+            vector<bool> keep(vertices.size());
+            for (int i = 0; i < vertices.size(); i++)
+                keep[i] = removedAt.find(vertices[i]->title) == removedAt.end();
+            for (int i = 0; i < vertices.size(); i++)
+                for (auto neighbour : outNeighbours(i))
+                    if (!keep[i] || !keep[neighbour.first])
+                        unlinked(i, neighbour.first);
+            for (int i = 0; i < vertices.size(); i++)
+                if (keep[i]){
+                    outDegrees[kept] = outDegrees[i];
+                    inDegrees[kept] = inDegrees[i];
+                    vertices[kept++] = vertices[i];
+                }
+                else{
+                    shift(outHistogram, 0, -1);
+                    shift(inHistogram, 0, -1);
+                }
+            vertices.resize(kept);
+            outDegrees.resize(kept);
+            inDegrees.resize(kept);
+
+            int row = 0;
+            for (int i = 0; i < keep.size(); i++){
+                if (!keep[i]) continue;
+                edges[row].swap(edges[i]);
+                int column = 0;
+                for (int j = 0; j < keep.size(); j++)
+                    if (keep[j]){
+                        edges[row][column] = place(edges[row][j], row, column);
+                        column++;
+                    }
+                edges[row].resize(kept);
+                row++;
+            }
+            edges.resize(kept);
+        }
+
+        // New vertices grow every row once
+        int n = vertices.size() + added.size();
+        for (int i = 0; i < vertices.size(); i++){
+            edges[i].reserve(n);
+            for (int j = vertices.size(); j < n; j++)
+                edges[i].push_back(place(new Edge<E>(), i, j));
+        }
+        for (int i = vertices.size(); i < n; i++){
+            edges.push_back(vector<Edge<E>*>());
+            edges.back().reserve(n);
+            for (int j = 0; j < n; j++)
+                edges.back().push_back(place(new Edge<E>(), i, j));
+        }
+        for (V value : added){
+            vertices.push_back(new Vertex<V>(value));
+            appendDegrees();
+        }
+        positionsStale = true;
+
+        // Edge mutations older than the last removal of an endpoint are void,
+        // the rest are deduplicated keeping the last one per cell
+        vector< tuple<int, int, int> > cells;
+        for (int k : changes){
+            auto& operation = operations[k];
+            auto from = removedAt.find(operation.from), to = removedAt.find(operation.to);
+            if ((from != removedAt.end() && from->second > k) || (to != removedAt.end() && to->second > k))
+                continue;
+            Vertex<V> fromVertex(operation.from), toVertex(operation.to);
+            cells.emplace_back(getIndex(&fromVertex), getIndex(&toVertex), k);
+        }
+        sort(cells.begin(), cells.end());
+        for (int c = 0; c < cells.size(); c++){
+            int i = get<0>(cells[c]), j = get<1>(cells[c]);
+            if (c + 1 < cells.size() && get<0>(cells[c + 1]) == i && get<1>(cells[c + 1]) == j)
+                continue;
+            auto& operation = operations[get<2>(cells[c])];
+            if (operation.type == Batch::ADD_EDGE)
+                setEdge(i, j, operation.weight);
+            else
+                removeEdge(edges[i][j]);
+        }
+    }
+
+public:
+
+
+    /**
+     * Method that determines whether graph is acyclic
+     * @param stack Order of the path
+     * @return True whether graph is acyclic
+     */
+    bool isAcyclic(vector<Vertex<V>*>& stack){
+        AcyclicitySearch<V, E> search(*this);
+        search.resume();
+        stack.clear();
+        for (int v : search.cycle)
+            stack.push_back(vertices[v]);
+        return stack.empty();
+    }
+
+    /**
+     * Method that finds the strongly connected components of the graph
+     * @return Components as collections of vertex indices
+     */
+    vector< vector<int> > stronglyConnectedComponents(){
+        int n = vertices.size(), counter = 0;
+        vector<int> index(n, -1), low(n, 0), next(n, 0), stack;
+        vector<bool> onStack(n, false);
+        vector< vector<int> > components;
+
+        // Iterative Tarjan, path holds the vertices of the current DFS branch
+        for (int root = 0; root < n; root++){
+            if (index[root] != -1) continue;
+            vector<int> path(1, root);
+            index[root] = low[root] = counter++;
+            stack.push_back(root);
+            onStack[root] = true;
+
+            while (!path.empty()){
+                int v = path.back();
+                if (next[v] < n){
+                    int w = next[v]++;
+                    if (edges[v][w]->isEmpty) continue;
+                    if (index[w] == -1){
+                        index[w] = low[w] = counter++;
+                        stack.push_back(w);
+                        onStack[w] = true;
+                        path.push_back(w);
+                    }
+                    else if (onStack[w])
+                        low[v] = min(low[v], index[w]);
+                    continue;
+                }
+
+                path.pop_back();
+                if (!path.empty())
+                    low[path.back()] = min(low[path.back()], low[v]);
+                if (low[v] == index[v]){
+                    vector<int> component;
+                    int w;
+                    do {
+                        w = stack.back();
+                        stack.pop_back();
+                        onStack[w] = false;
+                        component.push_back(w);
+                    } while (w != v);
+                    components.push_back(component);
+                }
+            }
+        }
+        return components;
+    }
+
+};
+
+/**
+ * Class AcyclicitySearch
+ * Resumable depth-first search for a cycle. Vertices are tried as roots in
+ * order and a vertex whose search finished without a cycle is never entered
+ * again, so the first cycle is the one the plain per-root search reports
+ * @tparam V Type of the title
+ * @tparam E Type of the weight
+ * @tparam Profile Profiling policy, NoProfile or QueryProfile
+ */
+template<typename V, typename E, typename Profile>
+class AcyclicitySearch{
+    enum Colour {WHITE, GREY, BLACK};
+
+    AdjacencyMatrixGraph<V, E>& graph;
+    Profile& profile;                   // Counters of the work done
+    vector<Colour> colour;              // Unvisited, on the path or finished without a cycle
+    vector<int> next;                   // Next neighbour to try from every vertex on the path
+    vector<int> path;                   // Current path from the root
+    int root = 0;                       // Next root to search from
+
+public:
+    long long budget = -1;              // Expansions left before resume() yields, -1 for no limit
+    vector<int> cycle;                  // Indices of the vertices of the cycle found, in order
+
+    /**
+     * Constructor with parameters
+     * @param graph Graph
+     * @param profile Counters of the work done
+     */
+    explicit AcyclicitySearch(AdjacencyMatrixGraph<V, E>& graph, Profile& profile = noProfile)
+        : graph(graph), profile(profile), colour(graph.vertices.size(), WHITE), next(graph.vertices.size(), 0){
+        profile.allocate(graph.vertices.size() * (sizeof(Colour) + sizeof(int)));
+    }
+
+    /**
+     * Method that continues the search
+     * @return Whether the search is over, with the cycle or without one
+     */
+    bool resume(){
+        int n = graph.vertices.size();
+        while (true){
+            if (path.empty()){
+                // A vertex without outgoing edges finishes at once, so it is not searched from
+                while (root < n && (colour[root] == BLACK || graph.outDegree(root) == 0))
+                    root++;
+                if (root == n)
+                    return true;
+                colour[root] = GREY;
+                path.push_back(root++);
+                enter();
+            }
+
+            while (!path.empty()){
+                if (budget == 0)
+                    return false;
+                if (budget > 0)
+                    budget--;
+
+                int v = path.back();
+                while (next[v] < n && graph.edges[v][next[v]]->isEmpty)
+                    next[v]++;
+                if (next[v] == n){
+                    colour[v] = BLACK;
+                    path.pop_back();
+                    profile.pop(sizeof(int));
+                    continue;
+                }
+
+                int w = next[v]++;
+                profile.scan();
+                if (colour[w] == GREY){
+                    cycle.assign(find(path.begin(), path.end(), w), path.end());
+                    return true;
+                }
+                if (colour[w] == WHITE && graph.outDegree(w) == 0)
+                    colour[w] = BLACK;
+                else if (colour[w] == WHITE){
+                    colour[w] = GREY;
+                    path.push_back(w);
+                    enter();
+                }
+            }
+        }
+    }
+
+private:
+    void enter(){
+        profile.settle();
+        profile.push(sizeof(int));
+        profile.reach(path.size());
+    }
+};
+
+/**
+ * Class CycleEnumerator
+ * Lazy enumeration of all elementary cycles with Johnson's algorithm,
+ * run one strongly connected component at a time
+ * @tparam V Type of the title
+ * @tparam E Type of the weight
+ */
+template<typename V, typename E>
+class CycleEnumerator{
+    /**
+     * Frame of the resumable circuit search
+     */
+    struct Frame{
+        int v;          // Local index of the vertex
+        int next;       // Position of the next neighbour to try
+        bool found;     // Whether a cycle through the vertex was found or pruned
+        E weight;       // Weight of the path from the start to the vertex
+    };
+
+    AdjacencyMatrixGraph<V, E>& graph;
+    int maxLength;                          // Longest cycle reported, 0 for no limit
+    E maxWeight;                            // Heaviest cycle reported, 0 for no limit
+
+    vector< vector<int> > components;       // Strongly connected components of the graph
+    int component = -1;                     // Component being enumerated
+    int start = 0;                          // Position of the next start vertex in the component
+
+    vector<int> nodes;                      // Graph indices of the current subcomponent
+    vector<int> local;                      // Local index of every graph vertex, -1 if outside
+    vector< vector< pair<int, E> > > adjacency;     // Local arcs of the subcomponent
+    vector<bool> blocked;
+    vector< vector<int> > blockedBy;        // Johnson's B lists
+    vector<Frame> frames;
+
+public:
+    long long budget = -1;                  // Search steps left before next() yields, -1 for no limit
+    bool finished = false;                  // Whether every cycle was produced
+
+    /**
+     * Constructor with parameters
+     * @param graph Graph
+     * @param maxLength Longest cycle to report, 0 for no limit
+     * @param maxWeight Heaviest cycle to report, 0 for no limit; assumes non-negative weights
+     */
+    CycleEnumerator(AdjacencyMatrixGraph<V, E>& graph, int maxLength = 0, E maxWeight = 0)
+        : graph(graph), maxLength(maxLength), maxWeight(maxWeight){
+        components = graph.stronglyConnectedComponents();
+        local.assign(graph.vertices.size(), -1);
+    }
+
+    /**
+     * Method that produces the next cycle
+     * @param cycle Indices of the vertices of the cycle
+     * @param weight Total weight of the cycle
+     * @return Whether a cycle was produced, false when finished or out of budget
+     */
+    bool next(vector<int>& cycle, E& weight){
+        while (budget != 0){
+            if (frames.empty() && !advance()){
+                finished = true;
+                return false;
+            }
+            if (resume(cycle, weight))
+                return true;
+        }
+        return false;
+    }
+
+    /**
+     * Input iterator over the remaining cycles
+     */
+    class iterator{
+        CycleEnumerator* owner;
+        pair<vector<int>, E> current;
+    public:
+        explicit iterator(CycleEnumerator* owner) : owner(owner){
+            ++*this;
+        }
+        const pair<vector<int>, E>& operator*() const{
+            return current;
+        }
+        iterator& operator++(){
+            if (owner && !owner->next(current.first, current.second))
+                owner = nullptr;
+            return *this;
+        }
+        bool operator!=(const iterator& other) const{
+            return owner != other.owner;
+        }
+    };
+
+    iterator begin(){
+        return iterator(this);
+    }
+
+    iterator end(){
+        return iterator(nullptr);
+    }
+
+private:
+    /**
+     * Method that prepares the search from the next start vertex
+     * @return False when every component is exhausted
+     */
+    bool advance(){
+        for (int v : nodes)
+            local[v] = -1;
+        nodes.clear();
+
+        while (true){
+            if (component == -1 || start == components[component].size()){
+                if (++component == components.size())
+                    return false;
+                sort(components[component].begin(), components[component].end());
+                start = 0;
+            }
+
+            // Subcomponent of the start vertex among the vertices of the component after it
+            vector<int>& members = components[component];
+            int s = members[start];
+            vector<int> forward = reach(members, start, false);
+            vector<int> backward = reach(members, start, true);
+            for (int v : forward)
+                local[v] = -2;
+            for (int v : backward)
+                if (local[v] == -2){
+                    local[v] = -3;
+                    nodes.push_back(v);
+                }
+            for (int v : forward)
+                local[v] = -1;
+            start++;
+
+            if (nodes.size() == 1 && graph.edges[s][s]->isEmpty){
+                local[s] = -1;
+                nodes.clear();
+                continue;
+            }
+
+            // Start vertex first, so that its local index is 0
+            sort(nodes.begin() + 1, nodes.end());
+            for (int i = 0; i < nodes.size(); i++)
+                local[nodes[i]] = i;
+            adjacency.assign(nodes.size(), vector< pair<int, E> >());
+            for (int i = 0; i < nodes.size(); i++)
+                for (int j = 0; j < nodes.size(); j++){
+                    Edge<E>* edge = graph.edges[nodes[i]][nodes[j]];
+                    if (!edge->isEmpty)
+                        adjacency[i].push_back({j, edge->weight});
+                }
+            blocked.assign(nodes.size(), false);
+            blockedBy.assign(nodes.size(), vector<int>());
+
+            blocked[0] = true;
+            frames.push_back({0, 0, false, 0});
+            return true;
+        }
+    }
+
+    /**
+     * Method that finds the vertices reachable from the start vertex
+     * among the members of the component from the start position on
+     * @param members Sorted vertices of the component
+     * @param position Position of the start vertex
+     * @param reversed Whether to follow edges backwards
+     * @return Reachable vertices, the start vertex first
+     */
+    vector<int> reach(vector<int>& members, int position, bool reversed){
+        vector<int> result(1, members[position]);
+        vector<bool> seen(members.size() - position, false);
+        seen[0] = true;
+        for (int i = 0; i < result.size(); i++)
+            for (int k = position; k < members.size(); k++){
+                int u = result[i], w = members[k];
+                Edge<E>* edge = reversed ? graph.edges[w][u] : graph.edges[u][w];
+                if (!seen[k - position] && !edge->isEmpty){
+                    seen[k - position] = true;
+                    result.push_back(w);
+                }
+            }
+        return result;
+    }
+
+    /**
+     * Method that continues the circuit search until the next cycle
+     * @param cycle Indices of the vertices of the cycle
+     * @param weight Total weight of the cycle
+     * @return Whether a cycle was produced, false when the search from the start is over
+     */
+    bool resume(vector<int>& cycle, E& weight){
+        while (!frames.empty()){
+            if (budget == 0)
+                return false;
+            if (budget > 0)
+                budget--;
+
+            Frame& frame = frames.back();
+            if (frame.next < adjacency[frame.v].size()){
+                int w = adjacency[frame.v][frame.next].first;
+                E total = frame.weight + adjacency[frame.v][frame.next].second;
+                frame.next++;
+
+                // Pruned branches count as found, so that no vertex stays blocked because of a limit
+                bool pruned = maxWeight != 0 && total > maxWeight;
+                if (w == 0){
+                    frame.found = true;
+                    if (pruned) continue;
+                    cycle.clear();
+                    for (Frame& f : frames)
+                        cycle.push_back(nodes[f.v]);
+                    weight = total;
+                    return true;
+                }
+                if (!blocked[w]){
+                    if (pruned || (maxLength != 0 && frames.size() >= maxLength)){
+                        frame.found = true;
+                        continue;
+                    }
+                    blocked[w] = true;
+                    frames.push_back({w, 0, false, total});
+                }
+                continue;
+            }
+
+            int v = frame.v;
+            bool found = frame.found;
+            if (found)
+                unblock(v);
+            else
+                for (auto& arc : adjacency[v])
+                    if (find(blockedBy[arc.first].begin(), blockedBy[arc.first].end(), v) == blockedBy[arc.first].end())
+                        blockedBy[arc.first].push_back(v);
+            frames.pop_back();
+            if (!frames.empty() && found)
+                frames.back().found = true;
+        }
+        return false;
+    }
+
+    /**
+     * Method that unblocks a vertex and everything blocked on it
+     * @param v Local index of the vertex
+     */
+    void unblock(int v){
+        vector<int> stack(1, v);
+        blocked[v] = false;
+        while (!stack.empty()){
+            int u = stack.back();
+            stack.pop_back();
+            for (int w : blockedBy[u])
+                if (blocked[w]){
+                    blocked[w] = false;
+                    stack.push_back(w);
+                }
+            blockedBy[u].clear();
+        }
+    }
+};
+
+/**
+ * Class WorkStealingPool
+ * Threads that run tasks from their own deque, newest first, and steal the
+ * oldest task of another thread once theirs is empty. Tasks may submit tasks;
+ * run() returns when every task has finished
+ */
+class WorkStealingPool{
+public:
+    typedef function<void()> Task;
+
+    atomic<long long> steals{0};        // Tasks taken from another thread's deque
+
+private:
+    /**
+     * Deque of one thread
+     */
+    struct Queue{
+        mutex lock;
+        deque<Task> tasks;
+    };
+
+    vector< unique_ptr<Queue> > queues;
+    atomic<long long> pending{0};       // Tasks submitted and not finished
+    static thread_local WorkStealingPool* current;  // Pool the current thread works for, pools may nest
+    static thread_local int self;                   // Queue of the current thread in that pool
+
+    bool take(int index, bool newest, Task& task){
+        Queue& queue = *queues[index];
+        lock_guard<mutex> guard(queue.lock);
+        if (queue.tasks.empty()) return false;
+        if (newest){
+            task = move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        else{
+            task = move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+        return true;
+    }
+
+    void work(int index){
+        WorkStealingPool* outerPool = current;
+        int outerSelf = self;
+        current = this;
+        self = index;
+        int count = queues.size();
+        Task task;
+        while (pending.load() > 0){
+            bool found = take(index, true, task);
+            for (int k = 1; k < count && !found; k++)
+                if (take((index + k) % count, false, task)){
+                    found = true;
+                    steals++;
+                }
+            if (!found){
+                this_thread::yield();
+                continue;
+            }
+            task();
+            pending--;
+        }
+        current = outerPool;
+        self = outerSelf;
+    }
+
+public:
+    /**
+     * Constructor with parameters
+     * @param threads Number of threads
+     */
+    explicit WorkStealingPool(int threads){
+        for (int i = 0; i < max(threads, 1); i++)
+            queues.emplace_back(new Queue());
+    }
+
+    /**
+     * Method that adds a task to the deque of the current thread
+     * @param task Task
+     */
+    void submit(Task task){
+        pending++;
+        Queue& queue = *queues[current == this ? self : 0];
+        lock_guard<mutex> guard(queue.lock);
+        queue.tasks.push_back(move(task));
+    }
+
+    /**
+     * Method that runs the submitted tasks and those they submit, the calling thread included
+     */
+    void run(){
+        vector<thread> workers;
+        for (int i = 1; i < queues.size(); i++)
+            workers.emplace_back(&WorkStealingPool::work, this, i);
+        work(0);
+        for (auto& worker : workers)
+            worker.join();
+    }
+};
+
+thread_local WorkStealingPool* WorkStealingPool::current = nullptr;
+thread_local int WorkStealingPool::self = 0;
+
+/**
+ * Class ParallelComponents
+ * Strongly connected components on several threads. Vertices without an
+ * incoming or an outgoing edge are trimmed first as components of their own;
+ * the rest is split by forward-backward search: the vertices both reachable
+ * from a pivot and reaching it form its component, and the three remaining
+ * parts become independent tasks of a work-stealing pool
+ * @tparam V Type of the title
+ * @tparam E Type of the weight
+ */
+template<typename V, typename E>
+class ParallelComponents{
+    static const int SPLIT = 4096;      // Parts at least this large search both directions at once
+
+    int n = 0;
+    vector<int> outStart, outTarget;    // Edges of the snapshot by source
+    vector<int> inStart, inSource;      // Edges of the snapshot by target
+    vector< atomic<int> > colour;       // Part of every vertex still without a component, -1 once it has one
+    vector<char> forward, backward;     // Reached by the searches of the vertex's part
+    atomic<int> colours{0};
+    atomic<int> components{0};
+
+public:
+    vector<int> component;              // Component of every vertex
+    int trimmed = 0;                    // Vertices removed by trimming
+    long long steals = 0;               // Tasks stolen by idle threads
+
+    /**
+     * Method that takes the snapshot of the graph
+     * @param graph Graph
+     */
+    void build(AdjacencyMatrixGraph<V, E>& graph){
+        n = graph.vertices.size();
+        outStart.assign(n + 1, 0);
+        inStart.assign(n + 1, 0);
+        for (int v = 0; v < n; v++){
+            outStart[v + 1] = outStart[v] + graph.outDegree(v);
+            inStart[v + 1] = inStart[v] + graph.inDegree(v);
+        }
+        outTarget.resize(graph.edgeCount());
+        for (int u = 0; u < n; u++){
+            if (graph.outDegree(u) == 0) continue;
+            int i = outStart[u];
+            for (auto neighbour : graph.outNeighbours(u))
+                outTarget[i++] = neighbour.first;
+        }
+        inSource.resize(outTarget.size());
+        vector<int> position(inStart.begin(), inStart.end() - 1);
+        for (int u = 0; u < n; u++)
+            for (int i = outStart[u]; i < outStart[u + 1]; i++)
+                inSource[position[outTarget[i]]++] = u;
+    }
+
+    /**
+     * Method that finds the components of the snapshot
+     * @param threads Number of threads
+     * @return Number of components
+     */
+    int run(int threads){
+        threads = max(threads, 1);
+        component.assign(n, -1);
+        colour = vector< atomic<int> >(n);
+        for (auto& part : colour)
+            part = 0;
+        forward.assign(n, 0);
+        backward.assign(n, 0);
+        colours = 1;
+        components = 0;
+        trim(threads);
+
+        vector<int> rest;
+        for (int v = 0; v < n; v++)
+            if (component[v] == -1)
+                rest.push_back(v);
+        WorkStealingPool pool(threads);
+        if (!rest.empty())
+            pool.submit([this, &pool, rest](){ split(pool, rest); });
+        pool.run();
+        steals = pool.steals;
+        return components;
+    }
+
+    /**
+     * Method that finds a cycle inside a component
+     * @param v Vertex of a component with a cycle
+     * @return Vertices of the cycle in order, starting with v, empty if there is none
+     */
+    vector<int> cycleThrough(int v){
+        vector<int> parent(n, -2);
+        vector<int> queue(1, v);
+        parent[v] = -1;
+        for (size_t head = 0; head < queue.size(); head++){
+            int u = queue[head];
+            for (int i = outStart[u]; i < outStart[u + 1]; i++){
+                int w = outTarget[i];
+                if (component[w] != component[v]) continue;
+                if (w == v){
+                    vector<int> cycle;
+                    for (int x = u; x != -1; x = parent[x])
+                        cycle.push_back(x);
+                    reverse(cycle.begin(), cycle.end());
+                    return cycle;
+                }
+                if (parent[w] == -2){
+                    parent[w] = u;
+                    queue.push_back(w);
+                }
+            }
+        }
+        return {};
+    }
+
+    /**
+     * Method that finds a cycle of the graph once the components are known
+     * @return Vertices of a cycle through the first vertex on one, empty if the graph is acyclic
+     */
+    vector<int> witness(){
+        vector<int> size(components.load(), 0);
+        for (int v = 0; v < n; v++)
+            size[component[v]]++;
+        for (int v = 0; v < n; v++){
+            bool loop = false;
+            for (int i = outStart[v]; i < outStart[v + 1] && !loop; i++)
+                loop = outTarget[i] == v;
+            if (size[component[v]] > 1 || loop)
+                return cycleThrough(v);
+        }
+        return {};
+    }
+
+private:
+    /**
+     * Method that gives every vertex without incoming or outgoing edges among
+     * the remaining ones a component of its own, peeling them on all threads
+     * @param threads Number of threads
+     */
+    void trim(int threads){
+        vector< atomic<int> > in(n), out(n);
+        vector< atomic<char> > removed(n);
+        for (int v = 0; v < n; v++){
+            in[v] = inStart[v + 1] - inStart[v];
+            out[v] = outStart[v + 1] - outStart[v];
+            removed[v] = 0;
+        }
+        atomic<int> count{0};
+
+        auto peel = [&](int begin, int end){
+            vector<int> stack;
+            for (int v = begin; v < end; v++)
+                if (in[v] == 0 || out[v] == 0)
+                    stack.push_back(v);
+            while (!stack.empty()){
+                int v = stack.back();
+                stack.pop_back();
+                if (removed[v].exchange(1)) continue;
+                component[v] = components++;
+                colour[v] = -1;
+                count++;
+                for (int i = outStart[v]; i < outStart[v + 1]; i++)
+                    if (--in[outTarget[i]] == 0)
+                        stack.push_back(outTarget[i]);
+                for (int i = inStart[v]; i < inStart[v + 1]; i++)
+                    if (--out[inSource[i]] == 0)
+                        stack.push_back(inSource[i]);
+            }
+        };
+
+        vector<thread> workers;
+        int chunk = (n + threads - 1) / threads;
+        for (int t = 1; t < threads; t++)
+            workers.emplace_back(peel, min(n, t * chunk), min(n, (t + 1) * chunk));
+        peel(0, min(n, chunk));
+        for (auto& worker : workers)
+            worker.join();
+        trimmed = count;
+    }
+
+    /**
+     * Method that marks the vertices of a part reachable from a pivot
+     * @param pivot Vertex of the part
+     * @param start Offsets of the edges to follow
+     * @param target Ends of the edges to follow
+     * @param reached Marks to set
+     */
+    void reach(int pivot, const vector<int>& start, const vector<int>& target, vector<char>& reached){
+        int part = colour[pivot];
+        vector<int> stack(1, pivot);
+        reached[pivot] = 1;
+        while (!stack.empty()){
+            int u = stack.back();
+            stack.pop_back();
+            for (int i = start[u]; i < start[u + 1]; i++){
+                int w = target[i];
+                if (colour[w] == part && !reached[w]){
+                    reached[w] = 1;
+                    stack.push_back(w);
+                }
+            }
+        }
+    }
+
+    /**
+     * Method that takes the component of a pivot out of a part and submits the rest
+     * @param pool Pool running the tasks
+     * @param part Vertices of the part, all of the same colour
+     */
+    void split(WorkStealingPool& pool, const vector<int>& part){
+        int pivot = part[0];
+        if (part.size() >= SPLIT){
+            thread back(&ParallelComponents::reach, this, pivot, cref(inStart), cref(inSource), ref(backward));
+            reach(pivot, outStart, outTarget, forward);
+            back.join();
+        }
+        else{
+            reach(pivot, outStart, outTarget, forward);
+            reach(pivot, inStart, inSource, backward);
+        }
+
+        int id = components++;
+        vector<int> parts[3];       // Only forward, only backward, neither
+        for (int v : part){
+            if (forward[v] && backward[v]){
+                component[v] = id;
+                colour[v] = -1;
+            }
+            else
+                parts[forward[v] ? 0 : backward[v] ? 1 : 2].push_back(v);
+            forward[v] = backward[v] = 0;
+        }
+        for (auto& rest : parts){
+            if (rest.empty()) continue;
+            int next = colours++;
+            for (int v : rest)
+                colour[v] = next;
+            if (rest.size() == 1){
+                component[rest[0]] = components++;
+                colour[rest[0]] = -1;
+                continue;
+            }
+            pool.submit([this, &pool, rest](){ split(pool, rest); });
+        }
+    }
+};
+
+/**
+ * Class PersistentMap
+ * Immutable hash array mapped trie from 32-bit keys to values. Every change
+ * copies the nodes on the path to its key and shares the rest, so a copy of
+ * the map is a snapshot taken in constant time
+ * @tparam T Type of the value
+ */
+template<typename T>
+class PersistentMap{
+    static const int BITS = 5;          // Bits of the hash consumed by every level
+
+    /**
+     * Node holding up to 32 slots, each either an entry or a subtree
+     */
+    struct Node{
+        uint32_t leaves = 0;                        // Slots holding an entry
+        uint32_t children = 0;                      // Slots holding a subtree
+        vector< pair<uint32_t, T> > entries;        // Entries in slot order
+        vector< shared_ptr<const Node> > nodes;     // Subtrees in slot order
+    };
+    typedef shared_ptr<const Node> Pointer;
+
+    Pointer root;
+    size_t count = 0;
+
+    /**
+     * Method that mixes a key, a bijection so distinct keys never collide
+     */
+    static uint32_t hash(uint32_t key){
+        key *= 0x9E3779B1u;
+        return key ^ (key >> 16);
+    }
+
+    static int rank(uint32_t bitmap, uint32_t bit){
+        return __builtin_popcount(bitmap & (bit - 1));
+    }
+
+    static Pointer split(int shift, uint32_t key, const T& value, uint32_t other, const T& otherValue){
+        auto node = make_shared<Node>();
+        uint32_t bit = 1u << ((hash(key) >> shift) & 31), otherBit = 1u << ((hash(other) >> shift) & 31);
+        if (bit == otherBit){
+            node->children = bit;
+            node->nodes.push_back(split(shift + BITS, key, value, other, otherValue));
+        }
+        else{
+            node->leaves = bit | otherBit;
+            node->entries.push_back({key, value});
+            node->entries.push_back({other, otherValue});
+            if (otherBit < bit)
+                swap(node->entries[0], node->entries[1]);
+        }
+        return node;
+    }
+
+    static Pointer insert(const Pointer& node, int shift, uint32_t key, const T& value, bool& added){
+        if (!node){
+            auto leaf = make_shared<Node>();
+            leaf->leaves = 1u << ((hash(key) >> shift) & 31);
+            leaf->entries.push_back({key, value});
+            added = true;
+            return leaf;
+        }
+        uint32_t bit = 1u << ((hash(key) >> shift) & 31);
+        auto copy = make_shared<Node>(*node);
+        if (node->children & bit){
+            auto& child = copy->nodes[rank(node->children, bit)];
+            child = insert(child, shift + BITS, key, value, added);
+        }
+        else if (node->leaves & bit){
+            int slot = rank(node->leaves, bit);
+            auto& entry = copy->entries[slot];
+            if (entry.first == key)
+                entry.second = value;
+            else{
+                Pointer child = split(shift + BITS, key, value, entry.first, entry.second);
+                copy->entries.erase(copy->entries.begin() + slot);
+                copy->leaves ^= bit;
+                copy->children |= bit;
+                copy->nodes.insert(copy->nodes.begin() + rank(copy->children, bit), child);
+                added = true;
+            }
+        }
+        else{
+            copy->entries.insert(copy->entries.begin() + rank(node->leaves, bit), {key, value});
+            copy->leaves |= bit;
+            added = true;
+        }
+        return copy;
+    }
+
+    static Pointer erase(const Pointer& node, int shift, uint32_t key, bool& removed){
+        uint32_t bit = 1u << ((hash(key) >> shift) & 31);
+        if (node->leaves & bit){
+            int slot = rank(node->leaves, bit);
+            if (node->entries[slot].first != key)
+                return node;
+            removed = true;
+            if (node->leaves == bit && node->children == 0)
+                return nullptr;
+            auto copy = make_shared<Node>(*node);
+            copy->entries.erase(copy->entries.begin() + slot);
+            copy->leaves ^= bit;
+            return copy;
+        }
+        if (!(node->children & bit))
+            return node;
+
+        int slot = rank(node->children, bit);
+        Pointer child = erase(node->nodes[slot], shift + BITS, key, removed);
+        if (!removed)
+            return node;
+        auto copy = make_shared<Node>(*node);
+        if (child && (child->children != 0 || child->entries.size() > 1)){
+            copy->nodes[slot] = child;
+            return copy;
+        }
+
+        // A subtree left with one entry or none folds into its parent
+        copy->nodes.erase(copy->nodes.begin() + slot);
+        copy->children ^= bit;
+        if (child){
+            copy->leaves |= bit;
+            copy->entries.insert(copy->entries.begin() + rank(copy->leaves, bit), child->entries[0]);
+        }
+        if (copy->leaves == 0 && copy->children == 0)
+            return nullptr;
+        return copy;
+    }
+
+    template<typename Function>
+    static void visit(const Node* node, Function& function){
+        for (auto& entry : node->entries)
+            function(entry.first, entry.second);
+        for (auto& child : node->nodes)
+            visit(child.get(), function);
+    }
+
+public:
+    /**
+     * Method that finds the value of a key
+     * @param key Key
+     * @return Pointer to the value, nullptr if the key is absent
+     */
+    const T* find(uint32_t key) const{
+        uint32_t mixed = hash(key);
+        for (const Node* node = root.get(); node; ){
+            uint32_t bit = 1u << (mixed & 31);
+            if (node->leaves & bit){
+                auto& entry = node->entries[rank(node->leaves, bit)];
+                return entry.first == key ? &entry.second : nullptr;
+            }
+            if (!(node->children & bit))
+                return nullptr;
+            node = node->nodes[rank(node->children, bit)].get();
+            mixed >>= BITS;
+        }
+        return nullptr;
+    }
+
+    /**
+     * Method that sets the value of a key, leaving copies made before unchanged
+     * @param key Key
+     * @param value Value
+     */
+    void set(uint32_t key, const T& value){
+        bool added = false;
+        root = insert(root, 0, key, value, added);
+        count += added;
+    }
+
+    /**
+     * Method that removes a key, leaving copies made before unchanged
+     * @param key Key
+     */
+    void erase(uint32_t key){
+        if (!root) return;
+        bool removed = false;
+        root = erase(root, 0, key, removed);
+        count -= removed;
+    }
+
+    /**
+     * Method that calls a function with every key and value, in no particular order
+     * @param function Function of the key and the value
+     */
+    template<typename Function>
+    void forEach(Function function) const{
+        if (root)
+            visit(root.get(), function);
+    }
+
+    size_t size() const{
+        return count;
+    }
+};
+
+/**
+ * Class PersistentGraph
+ * Version of a graph kept in persistent maps: every vertex has a row with
+ * its outgoing and incoming edges, and the rows are a map of their own. A
+ * mutation copies O(log n) nodes, so versions share everything they did not
+ * change, and copying the object snapshots the graph
+ * @tparam E Type of the weight
+ */
+template<typename E>
+class PersistentGraph{
+public:
+    /**
+     * Vertex with its edges
+     */
+    struct Row{
+        uint64_t order;                 // Position among the vertices, by the time it was added
+        PersistentMap<E> out, in;       // Weights of the edges by the other end, as stored
+    };
+
+private:
+    PersistentMap<Row> rows;            // Rows by title
+    bool transposed = false;            // Whether stored edges run from target to source
+    uint64_t added = 0;                 // Vertices ever added
+    size_t arcs = 0;                    // Number of edges
+
+    void link(uint32_t from, uint32_t to, E weight){
+        if (transposed)
+            swap(from, to);
+        Row source = *rows.find(from);
+        size_t before = source.out.size();
+        source.out.set(to, weight);
+        arcs += source.out.size() - before;
+        rows.set(from, source);
+        Row target = *rows.find(to);
+        target.in.set(from, weight);
+        rows.set(to, target);
+    }
+
+    void unlink(uint32_t from, uint32_t to){
+        if (transposed)
+            swap(from, to);
+        Row source = *rows.find(from);
+        size_t before = source.out.size();
+        source.out.erase(to);
+        arcs -= before - source.out.size();
+        rows.set(from, source);
+        Row target = *rows.find(to);
+        target.in.erase(from);
+        rows.set(to, target);
+    }
+
+    const PersistentMap<E>& outgoing(const Row& row) const{
+        return transposed ? row.in : row.out;
+    }
+
+public:
+    /**
+     * Method that builds the version of a graph
+     * @param graph Graph
+     */
+    template<typename V>
+    void assign(AdjacencyMatrixGraph<V, E>& graph){
+        *this = PersistentGraph();
+        for (auto vertex : graph.vertices)
+            addVertex(vertex->title);
+        for (int u = 0; u < graph.vertices.size(); u++)
+            for (auto neighbour : graph.outNeighbours(u))
+                addEdge(graph.vertices[u]->title, graph.vertices[neighbour.first]->title, neighbour.second->weight);
+    }
+
+    /**
+     * Method that applies a mutation as the matrix does one at a time,
+     * edges between vertices that are missing are ignored
+     * @param type Type of the mutation, GraphBatch::Type
+     * @param from Title of the vertex or of the source of the edge
+     * @param to Title of the target of the edge
+     * @param weight Weight of the added edge
+     */
+    void apply(int type, uint32_t from, uint32_t to, E weight){
+        typedef GraphBatch<uint32_t, E> Batch;
+        if (type == Batch::ADD_VERTEX)
+            addVertex(from);
+        else if (type == Batch::REMOVE_VERTEX)
+            removeVertex(from);
+        else if (type == Batch::ADD_EDGE)
+            addEdge(from, to, weight);
+        else if (type == Batch::REMOVE_EDGE)
+            removeEdge(from, to);
+        else if (type == Batch::TRANSPOSE)
+            transpose();
+    }
+
+    void addVertex(uint32_t title){
+        if (!rows.find(title))
+            rows.set(title, Row{added++, PersistentMap<E>(), PersistentMap<E>()});
+    }
+
+    void removeVertex(uint32_t title){
+        const Row* row = rows.find(title);
+        if (!row) return;
+        Row removed = *row;
+        removed.out.forEach([&](uint32_t to, const E&){
+            if (to == title) return;
+            Row target = *rows.find(to);
+            target.in.erase(title);
+            rows.set(to, target);
+        });
+        removed.in.forEach([&](uint32_t from, const E&){
+            if (from == title) return;
+            Row source = *rows.find(from);
+            source.out.erase(title);
+            rows.set(from, source);
+            arcs--;
+        });
+        arcs -= removed.out.size();
+        rows.erase(title);
+    }
+
+    void addEdge(uint32_t from, uint32_t to, E weight){
+        if (rows.find(from) && rows.find(to))
+            link(from, to, weight);
+    }
+
+    void removeEdge(uint32_t from, uint32_t to){
+        if (hasEdge(from, to))
+            unlink(from, to);
+    }
+
+    /**
+     * Method that reverses every edge in constant time, swapping the roles of the stored maps
+     */
+    void transpose(){
+        transposed = !transposed;
+    }
+
+    bool hasEdge(uint32_t from, uint32_t to) const{
+        return weight(from, to) != nullptr;
+    }
+
+    /**
+     * Method that finds the weight of an edge
+     * @return Pointer to the weight, nullptr if there is no such edge
+     */
+    const E* weight(uint32_t from, uint32_t to) const{
+        if (transposed)
+            swap(from, to);
+        const Row* row = rows.find(from);
+        return row ? row->out.find(to) : nullptr;
+    }
+
+    size_t vertexCount() const{
+        return rows.size();
+    }
+
+    size_t edgeCount() const{
+        return arcs;
+    }
+
+    /**
+     * Method that lists the vertices in the order of the matrix
+     * @return Titles of the vertices
+     */
+    vector<uint32_t> vertices() const{
+        vector< pair<uint64_t, uint32_t> > ordered;
+        rows.forEach([&](uint32_t title, const Row& row){ ordered.push_back({row.order, title}); });
+        sort(ordered.begin(), ordered.end());
+        vector<uint32_t> titles;
+        for (auto& vertex : ordered)
+            titles.push_back(vertex.second);
+        return titles;
+    }
+
+    /**
+     * Method that lists the edges going from a vertex in the order of the matrix
+     * @param title Title of the vertex
+     * @return Pairs of the target and the weight
+     */
+    vector< pair<uint32_t, E> > outNeighbours(uint32_t title) const{
+        vector< tuple<uint64_t, uint32_t, E> > ordered;
+        const Row* row = rows.find(title);
+        if (row)
+            outgoing(*row).forEach([&](uint32_t to, const E& weight){
+                ordered.emplace_back(rows.find(to)->order, to, weight);
+            });
+        sort(ordered.begin(), ordered.end());
+        vector< pair<uint32_t, E> > result;
+        for (auto& edge : ordered)
+            result.push_back({get<1>(edge), get<2>(edge)});
+        return result;
+    }
+
+    /**
+     * Method that finds a cycle with the same depth-first search as IS_ACYCLIC
+     * @return Titles of the vertices of the cycle in order, empty if the version is acyclic
+     */
+    vector<uint32_t> findCycle() const{
+        enum Colour {WHITE, GREY, BLACK};
+        unordered_map<uint32_t, Colour> colour;
+        for (uint32_t root : vertices()){
+            if (colour[root] != WHITE) continue;
+            vector<uint32_t> path(1, root);
+            vector< vector< pair<uint32_t, E> > > edges(1, outNeighbours(root));
+            vector<size_t> next(1, 0);
+            colour[root] = GREY;
+            while (!path.empty()){
+                if (next.back() == edges.back().size()){
+                    colour[path.back()] = BLACK;
+                    path.pop_back();
+                    edges.pop_back();
+                    next.pop_back();
+                    continue;
+                }
+                uint32_t w = edges.back()[next.back()++].first;
+                if (colour[w] == GREY)
+                    return vector<uint32_t>(find(path.begin(), path.end(), w), path.end());
+                if (colour[w] == WHITE){
+                    colour[w] = GREY;
+                    path.push_back(w);
+                    edges.push_back(outNeighbours(w));
+                    next.push_back(0);
+                }
+            }
+        }
+        return {};
+    }
+
+    /**
+     * Method that finds the shortest path with Dijkstra's algorithm, the weights must not be negative
+     * @param from Title of the source
+     * @param to Title of the target
+     * @param path Titles of the vertices of the path, empty if there is none
+     * @return Length of the path
+     */
+    E shortestPath(uint32_t from, uint32_t to, vector<uint32_t>& path) const{
+        typedef pair<E, uint32_t> Entry;
+        unordered_map<uint32_t, E> distance;
+        unordered_map<uint32_t, uint32_t> parent;
+        priority_queue<Entry, vector<Entry>, greater<Entry>> queue;
+        path.clear();
+        if (!rows.find(from) || !rows.find(to))
+            return E();
+
+        distance[from] = E();
+        queue.push({E(), from});
+        while (!queue.empty()){
+            auto [length, u] = queue.top();
+            queue.pop();
+            if (length != distance[u]) continue;
+            if (u == to) break;
+            outgoing(*rows.find(u)).forEach([&](uint32_t w, const E& weight){
+                auto known = distance.find(w);
+                if (known == distance.end() || length + weight < known->second){
+                    distance[w] = length + weight;
+                    parent[w] = u;
+                    queue.push({length + weight, w});
+                }
+            });
+        }
+        if (distance.find(to) == distance.end())
+            return E();
+        for (uint32_t v = to; v != from; v = parent[v])
+            path.push_back(v);
+        path.push_back(from);
+        reverse(path.begin(), path.end());
+        return distance[to];
+    }
+};
+
+/**
+ * Class SymbolTable
+ * Interns vertex titles into dense 32-bit identifiers, keeping every
+ * title once in an arena together with its precomputed hash
+ */
+class SymbolTable{
+public:
+    static const uint32_t NONE = UINT32_MAX;   // Identifier of an unknown title
+
+private:
+    static constexpr size_t CHUNK = 1 << 16;    // Size of an arena chunk in bytes
+
+    /**
+     * Interned title
+     */
+    struct Symbol{
+        const char* data;   // Characters in the arena
+        uint32_t length;    // Number of characters
+        uint32_t hash;      // Hash of the characters
+    };
+
+    vector< unique_ptr<char[]> > chunks;        // Arena holding the characters
+    size_t used = CHUNK;                        // Bytes used in the last chunk
+    vector<Symbol> symbols;                     // Titles by identifier
+    vector<uint32_t> slots;                     // Open addressing table of identifier + 1
+
+    static uint32_t hashOf(string_view title){
+        uint32_t hash = 2166136261u;
+        for (char c : title){
+            hash ^= (unsigned char) c;
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    /**
+     * Method that finds the slot of a title
+     * @param title Title
+     * @param hash Hash of the title
+     * @return Index of the slot holding the title or of the empty slot where it belongs
+     */
+    size_t probe(string_view title, uint32_t hash) const{
+        size_t mask = slots.size() - 1;
+        for (size_t i = hash & mask; ; i = (i + 1) & mask){
+            if (slots[i] == 0)
+                return i;
+            const Symbol& symbol = symbols[slots[i] - 1];
+            if (symbol.hash == hash && string_view(symbol.data, symbol.length) == title)
+                return i;
+        }
+    }
+
+    const char* store(string_view title){
+        if (used + title.size() > CHUNK){
+            chunks.emplace_back(new char[max(CHUNK, title.size())]);
+            used = 0;
+        }
+        char* data = chunks.back().get() + used;
+        memcpy(data, title.data(), title.size());
+        used += title.size();
+        return data;
+    }
+
+    void grow(){
+        vector<uint32_t> larger(max<size_t>(16, slots.size() * 2), 0);
+        slots.swap(larger);
+        for (uint32_t id = 0; id < symbols.size(); id++){
+            size_t mask = slots.size() - 1, i = symbols[id].hash & mask;
+            while (slots[i] != 0)
+                i = (i + 1) & mask;
+            slots[i] = id + 1;
+        }
+    }
+
+public:
+    /**
+     * Method that returns the identifier of a title, adding it if needed
+     * @param title Title
+     * @return Identifier
+     */
+    uint32_t intern(string_view title){
+        if (2 * (symbols.size() + 1) > slots.size())
+            grow();
+        uint32_t hash = hashOf(title);
+        size_t slot = probe(title, hash);
+        if (slots[slot] == 0){
+            symbols.push_back({store(title), (uint32_t) title.size(), hash});
+            slots[slot] = symbols.size();
+        }
+        return slots[slot] - 1;
+    }
+
+    /**
+     * Method that returns the identifier of a title without adding it
+     * @param title Title
+     * @return Identifier, NONE if the title was never interned
+     */
+    uint32_t find(string_view title) const{
+        if (slots.empty())
+            return NONE;
+        return slots[probe(title, hashOf(title))] - 1;
+    }
+
+    /**
+     * Method that returns the title of an identifier
+     * @param id Identifier
+     * @return Title
+     */
+    string_view title(uint32_t id) const{
+        return string_view(symbols[id].data, symbols[id].length);
+    }
+
+    /**
+     * Method that returns the number of interned titles
+     * @return Number of titles
+     */
+    size_t size() const{
+        return symbols.size();
+    }
+};
+
+/**
+ * Class WriteAheadLog
+ * Append-only binary log of mutation commands split into numbered segments;
+ * checkpoints are written by a background thread and retire older segments
+ * @tparam E Type of the weight
+ */
+template<typename E>
+class WriteAheadLog{
+public:
+    enum Durability {NONE, GROUP, FULL};
+    enum Marker {BEGIN = 16, COMMIT, ROLLBACK};
+
+    /**
+     * Logged mutation command
+     */
+    struct Record{
+        int type;           // Type of a GraphBatch operation or a marker
+        string from;        // Title of the vertex or of the source of the edge
+        string to;          // Title of the target of the edge
+        E weight;           // Weight of the added edge
+    };
+
+    long long records = 0;          // Records appended since the last checkpoint
+
+private:
+    string directory;               // Directory holding the segments and the checkpoint
+    Durability durability = GROUP;  // When appended records are forced to disk
+    int groupSize = 64;             // Records per fsync in GROUP mode
+    int file = -1;                  // Descriptor of the current segment
+    int segment = 0;                // Number of the current segment
+    string buffer;                  // Encoded records not yet written
+    int pending = 0;                // Records in the buffer since the last fsync
+    thread checkpointer;            // Background checkpoint writer
+
+    static_assert(is_trivially_copyable<E>::value, "weights must be trivially copyable");
+
+public:
+    ~WriteAheadLog(){
+        close();
+    }
+
+    /**
+     * Method that sets where and how the log is kept
+     * @param path Directory of the log
+     * @param mode Durability of appended records
+     * @param group Records per fsync in GROUP mode
+     */
+    void configure(const string& path, Durability mode, int group){
+        directory = path;
+        durability = mode;
+        groupSize = max(group, 1);
+        mkdir(directory.c_str(), 0755);
+    }
+
+    bool isOpen(){
+        return file != -1;
+    }
+
+    /**
+     * Method that loads the latest checkpoint, replays the log written after it
+     * and opens a new segment for appending
+     * @param graph Empty graph to restore
+     * @param symbols Symbol table of the graph
+     * @param replay Function applying one logged command
+     * @return Number of replayed records
+     */
+    long long recover(AdjacencyMatrixGraph<uint32_t, E>& graph, SymbolTable& symbols,
+                      const function<void(const Record&)>& replay){
+        string data;
+        if (readFile(directory + "/checkpoint", data))
+            loadCheckpoint(data, graph, symbols);
+
+        long long replayed = 0;
+        for (int k = segment; readFile(segmentPath(k), data); k++){
+            Record record;
+            size_t offset = 0;
+            while (decode(data, offset, record)){
+                replay(record);
+                replayed++;
+            }
+            // Transactions never span segments, one left open was cut by a crash
+            replay({ROLLBACK, "", "", E()});
+            segment = k + 1;
+        }
+
+        file = open(segmentPath(segment).c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+        syncDirectory();
+        records = replayed;
+        return replayed;
+    }
+
+    /**
+     * Method that appends a command to the log
+     * @param type Type of a GraphBatch operation or a marker
+     * @param from Title of the vertex or of the source of the edge
+     * @param to Title of the target of the edge
+     * @param weight Weight of the added edge
+     */
+    void append(int type, string_view from, string_view to, E weight){
+        size_t start = buffer.size();
+        buffer.append(8, '\0');
+        buffer.push_back((char) type);
+        putString(from);
+        putString(to);
+        buffer.append((const char*) &weight, sizeof(weight));
+
+        uint32_t length = buffer.size() - start - 8;
+        uint32_t checksum = checksumOf(buffer.data() + start + 8, length);
+        memcpy(&buffer[start], &length, 4);
+        memcpy(&buffer[start + 4], &checksum, 4);
+        records++;
+        pending++;
+
+        // A commit is the point a caller relies on, so it ends the group early
+        if (durability == FULL || (durability == GROUP && (pending >= groupSize || type == COMMIT)))
+            sync();
+        else if (buffer.size() >= (1 << 20))
+            flush();
+    }
+
+    /**
+     * Method that writes buffered records and forces them to disk unless durability is NONE
+     */
+    void sync(){
+        flush();
+        if (durability != NONE && file != -1)
+            fsync(file);
+        pending = 0;
+    }
+
+    /**
+     * Method that snapshots the graph, switches to a new segment and lets a
+     * background thread write the checkpoint and remove the covered segments
+     * @param graph Graph
+     * @param symbols Symbol table of the graph
+     */
+    void checkpoint(AdjacencyMatrixGraph<uint32_t, E>& graph, SymbolTable& symbols){
+        string snapshot;
+        int covered = segment + 1;
+        putValue(snapshot, covered);
+        putValue(snapshot, (uint32_t) graph.vertices.size());
+        for (auto vertex : graph.vertices){
+            string_view title = symbols.title(vertex->title);
+            putValue(snapshot, (uint32_t) title.size());
+            snapshot.append(title.data(), title.size());
+        }
+        for (int i = 0; i < graph.vertices.size(); i++)
+            for (auto neighbour : graph.outNeighbours(i)){
+                putValue(snapshot, (uint32_t) i);
+                putValue(snapshot, (uint32_t) neighbour.first);
+                putValue(snapshot, neighbour.second->weight);
+            }
+
+        sync();
+        ::close(file);
+        segment = covered;
+        file = open(segmentPath(segment).c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+        syncDirectory();
+        records = 0;
+
+        if (checkpointer.joinable())
+            checkpointer.join();
+        string path = directory;
+        checkpointer = thread([path, covered, snapshot](){
+            string temporary = path + "/checkpoint.tmp";
+            int out = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (out == -1) return;
+            bool written = write(out, snapshot.data(), snapshot.size()) == (ssize_t) snapshot.size();
+            fsync(out);
+            ::close(out);
+            if (!written || rename(temporary.c_str(), (path + "/checkpoint").c_str()) != 0) return;
+
+            // The checkpoint is durable, so the segments it covers can go
+            for (int k = covered - 1; k >= 0 && unlink(segmentPath(path, k).c_str()) == 0; k--);
+        });
+    }
+
+    /**
+     * Method that flushes the log and waits for a running checkpoint
+     */
+    void close(){
+        if (file != -1){
+            sync();
+            ::close(file);
+            file = -1;
+        }
+        if (checkpointer.joinable())
+            checkpointer.join();
+    }
+
+private:
+    static string segmentPath(const string& path, int k){
+        char name[32];
+        snprintf(name, sizeof(name), "/wal.%08d", k);
+        return path + name;
+    }
+
+    string segmentPath(int k){
+        return segmentPath(directory, k);
+    }
+
+    void syncDirectory(){
+        int descriptor = open(directory.c_str(), O_RDONLY);
+        if (descriptor != -1){
+            fsync(descriptor);
+            ::close(descriptor);
+        }
+    }
+
+    void flush(){
+        if (file != -1 && !buffer.empty() && write(file, buffer.data(), buffer.size()) != (ssize_t) buffer.size())
+            cerr << "write-ahead log: write failed" << endl;
+        buffer.clear();
+    }
+
+    static uint32_t checksumOf(const char* data, size_t length){
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < length; i++){
+            hash ^= (unsigned char) data[i];
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    template<typename T>
+    static void putValue(string& out, T value){
+        out.append((const char*) &value, sizeof(value));
+    }
+
+    template<typename T>
+    static bool getValue(const string& data, size_t& offset, T& value){
+        if (offset + sizeof(value) > data.size()) return false;
+        memcpy(&value, data.data() + offset, sizeof(value));
+        offset += sizeof(value);
+        return true;
+    }
+
+    void putString(string_view value){
+        putValue(buffer, (uint16_t) value.size());
+        buffer.append(value.data(), value.size());
+    }
+
+    static bool getString(const string& data, size_t& offset, size_t end, string& value){
+        uint16_t length;
+        if (!getValue(data, offset, length) || offset + length > end) return false;
+        value.assign(data, offset, length);
+        offset += length;
+        return true;
+    }
+
+    static bool readFile(const string& path, string& data){
+        ifstream in(path, ios::binary);
+        if (!in) return false;
+        data.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+        return true;
+    }
+
+    /**
+     * Method that decodes the next record, stopping at a torn or corrupt tail
+     * @param data Contents of a segment
+     * @param offset Position of the record, moved past it
+     * @param record Decoded record
+     * @return Whether a complete record was decoded
+     */
+    static bool decode(const string& data, size_t& offset, Record& record){
+        uint32_t length, checksum;
+        size_t start = offset;
+        if (!getValue(data, offset, length) || !getValue(data, offset, checksum)
+            || offset + length > data.size() || checksumOf(data.data() + offset, length) != checksum){
+            offset = start;
+            return false;
+        }
+        size_t end = offset + length;
+        record.type = (unsigned char) data[offset++];
+        bool valid = getString(data, offset, end, record.from) && getString(data, offset, end, record.to)
+                     && getValue(data, offset, record.weight) && offset == end;
+        offset = end;
+        return valid;
+    }
+
+    /**
+     * Method that restores the graph from a checkpoint in a single batch
+     * @param data Contents of the checkpoint
+     * @param graph Empty graph
+     * @param symbols Symbol table of the graph
+     */
+    void loadCheckpoint(const string& data, AdjacencyMatrixGraph<uint32_t, E>& graph, SymbolTable& symbols){
+        size_t offset = 0;
+        uint32_t count = 0, from, to, length;
+        if (!getValue(data, offset, segment) || !getValue(data, offset, count)) return;
+
+        GraphBatch<uint32_t, E> batch;
+        vector<uint32_t> ids;
+        for (uint32_t i = 0; i < count && getValue(data, offset, length) && offset + length <= data.size(); i++){
+            ids.push_back(symbols.intern(string_view(data.data() + offset, length)));
+            batch.addVertex(ids.back());
+            offset += length;
+        }
+        E weight;
+        while (getValue(data, offset, from) && getValue(data, offset, to) && getValue(data, offset, weight))
+            if (from < ids.size() && to < ids.size())
+                batch.addEdge(ids[from], ids[to], weight);
+        graph.apply(batch);
+    }
+};
+
+/**
+ * Class QueryExecutor
+ * Cooperative scheduler of long queries. Every round resumes each query for
+ * a bounded number of search steps, so that other commands are served
+ * between rounds. Queries may carry a deadline and be cancelled by id
+ */
+class QueryExecutor{
+public:
+    typedef chrono::steady_clock Clock;
+
+    /**
+     * Resumable query: continues for at most budget steps, writing its answer,
+     * and returns whether it is over
+     */
+    typedef function<bool(long long budget, ostream& answer)> Query;
+
+private:
+    /**
+     * Query in flight
+     */
+    struct Task{
+        string id;              // Identifier chosen by the client
+        ostream* out;           // Where the answer goes
+        Clock::time_point deadline;
+        bool cancelled;
+        Query query;
+        ostringstream answer;   // Answer written so far
+    };
+
+    long long slice;            // Search steps per query per round
+    list<Task> tasks;
+
+public:
+    /**
+     * Constructor with parameters
+     * @param slice Search steps per query per round
+     */
+    explicit QueryExecutor(long long slice): slice(max(slice, 1LL)){}
+
+    bool idle(){
+        return tasks.empty();
+    }
+
+    /**
+     * Method that starts a query
+     * @param id Identifier of the query
+     * @param out Stream of the answer
+     * @param timeout Milliseconds until the query is abandoned, 0 for no limit
+     * @param query Resumable query
+     */
+    void submit(const string& id, ostream& out, long long timeout, Query query){
+        auto deadline = timeout > 0 ? Clock::now() + chrono::milliseconds(timeout) : Clock::time_point::max();
+        tasks.push_back({id, &out, deadline, false, query, ostringstream()});
+    }
+
+    /**
+     * Method that cancels the queries with an identifier
+     * @param id Identifier of the query
+     */
+    void cancel(const string& id){
+        for (auto& task : tasks)
+            if (task.id == id)
+                task.cancelled = true;
+    }
+
+    /**
+     * Method that cancels every query, used when the graph changes under them
+     */
+    void cancelAll(){
+        for (auto& task : tasks)
+            task.cancelled = true;
+    }
+
+    /**
+     * Method that determines whether queries still answer to a stream
+     * @param out Stream of the answers
+     * @return Whether an answer is owed
+     */
+    bool owes(ostream& out){
+        for (auto& task : tasks)
+            if (task.out == &out)
+                return true;
+        return false;
+    }
+
+    /**
+     * Method that drops the queries answering to a stream that went away
+     * @param out Stream of the answers
+     */
+    void forget(ostream& out){
+        tasks.remove_if([&](const Task& task){ return task.out == &out; });
+    }
+
+    /**
+     * Method that resumes every query once
+     * @return Whether queries remain in flight
+     */
+    bool run(){
+        if (tasks.empty())
+            return false;
+        auto now = Clock::now();
+        for (auto task = tasks.begin(); task != tasks.end();){
+            bool over = true;
+            if (task->cancelled)
+                respond(task->id, *task->out, "CANCELLED\n");
+            else if (now >= task->deadline)
+                respond(task->id, *task->out, "TIMEOUT\n");
+            else if (task->query(slice, task->answer))
+                respond(task->id, *task->out, task->answer.str());
+            else{
+                // Complete lines are passed on as they are produced
+                string answer = task->answer.str();
+                size_t end = answer.rfind('\n');
+                if (end != string::npos){
+                    respond(task->id, *task->out, answer.substr(0, end + 1));
+                    task->answer.str(answer.substr(end + 1));
+                    task->answer.seekp(0, ios::end);
+                }
+                over = false;
             }
+            task = over ? tasks.erase(task) : next(task);
         }
-        stack.clear();
+        return !tasks.empty();
+    }
+
+    /**
+     * Method that writes an answer, every line prefixed with the identifier of the query
+     * @param id Identifier of the query
+     * @param out Stream of the answer
+     * @param answer Lines of the answer
+     */
+    static void respond(const string& id, ostream& out, const string& answer){
+        for (size_t begin = 0, end; begin < answer.size(); begin = end + 1){
+            end = answer.find('\n', begin);
+            if (end == string::npos)
+                end = answer.size();
+            out << id << " ";
+            out.write(answer.data() + begin, end - begin);
+            out << '\n';
+        }
+        out.flush();
+    }
+};
+
+/**
+ * Class OrderedExecutor
+ * Reads commands ahead and answers each run of read-only commands between
+ * barriers on a work-stealing pool, every command into a buffer of its own.
+ * The buffers are written in the order of the stream, so the output is the
+ * same for any number of threads
+ */
+class OrderedExecutor{
+public:
+    typedef function<void(const string&, istream&, ostream&)> Execute;
+
+    /**
+     * Reads the arguments of a read-only command; false for a barrier, whose arguments are left unread
+     */
+    typedef function<bool(const string&, istream&, string&)> Arguments;
+
+private:
+    static const int RUN = 1 << 14;     // Commands read ahead at most
+
+    int threads;
+    Execute execute;
+    Arguments arguments;
+
+    /**
+     * Method that answers the pending commands and writes their answers in order
+     * @param pending Commands with their arguments, emptied afterwards
+     * @param out Stream of the answers
+     */
+    void answer(vector< pair<string, string> >& pending, ostream& out){
+        if (pending.empty()) return;
+        vector<string> answers(pending.size());
+        auto answerRange = [&](int begin, int end){
+            for (int i = begin; i < end; i++){
+                istringstream in(pending[i].second);
+                ostringstream answer;
+                execute(pending[i].first, in, answer);
+                answers[i] = answer.str();
+            }
+        };
+
+        int count = pending.size();
+        if (threads == 1 || count == 1)
+            answerRange(0, count);
+        else{
+            // Small tasks, so that idle threads find work to steal
+            WorkStealingPool pool(threads);
+            int chunk = max(1, count / (threads * 8));
+            for (int begin = 0; begin < count; begin += chunk)
+                pool.submit([&, begin, chunk, count](){ answerRange(begin, min(begin + chunk, count)); });
+            pool.run();
+        }
+
+        for (auto& answer : answers)
+            out << answer;
+        out.flush();
+        pending.clear();
+    }
+
+public:
+    /**
+     * Constructor with parameters
+     * @param threads Number of threads
+     * @param execute Function executing one command
+     * @param arguments Function reading the arguments of a read-only command
+     */
+    OrderedExecutor(int threads, Execute execute, Arguments arguments)
+        : threads(max(threads, 1)), execute(move(execute)), arguments(move(arguments)){}
+
+    /**
+     * Method that executes a stream of commands. Read-only commands are held
+     * back until a barrier, the end of the input or a pause in it
+     * @param in Commands
+     * @param out Answers
+     * @param idle Function telling whether no background work would interleave with the answers
+     * @param between Function called after every command executed alone
+     */
+    void run(istream& in, ostream& out, const function<bool()>& idle, const function<void()>& between){
+        vector< pair<string, string> > pending;
+        string cmd, read;
+        while (in >> cmd){
+            if (idle() && arguments(cmd, in, read)){
+                pending.push_back({cmd, read});
+
+                // The line break after the arguments is not input waiting
+                streambuf* buffer = in.rdbuf();
+                while (buffer->in_avail() > 0 && isspace(buffer->sgetc()))
+                    buffer->sbumpc();
+                if (pending.size() < RUN && buffer->in_avail() > 0)
+                    continue;
+                answer(pending, out);
+                continue;
+            }
+            answer(pending, out);
+            execute(cmd, in, out);
+            between();
+        }
+        answer(pending, out);
+    }
+};
+
+/**
+ * Class ReplyBuffer
+ * Output buffer of a connection, reused between requests
+ */
+class ReplyBuffer: public streambuf{
+public:
+    vector<char> data;      // Bytes not yet sent
+    size_t sent = 0;        // Bytes of data already sent
+
+protected:
+    int_type overflow(int_type c) override{
+        if (c != traits_type::eof())
+            data.push_back(c);
+        return c;
+    }
+
+    streamsize xsputn(const char* s, streamsize n) override{
+        data.insert(data.end(), s, s + n);
+        return n;
+    }
+};
+
+/**
+ * Class RequestBuffer
+ * Input buffer of a connection exposing the complete lines received so far
+ */
+class RequestBuffer: public streambuf{
+public:
+    vector<char> data = vector<char>(1 << 16);  // Received bytes
+    size_t used = 0;                            // Bytes of data filled
+
+    /**
+     * Method that exposes the received bytes up to the last complete line
+     * @return Whether there is a complete line
+     */
+    bool expose(){
+        size_t end = used;
+        while (end > 0 && data[end - 1] != '\n')
+            end--;
+        setg(data.data(), data.data(), data.data() + end);
+        return end > 0;
+    }
+
+    /**
+     * Method that drops the exposed bytes, keeping an incomplete line
+     */
+    void consume(){
+        size_t end = egptr() - eback();
+        memmove(data.data(), data.data() + end, used - end);
+        used -= end;
+        setg(data.data(), data.data(), data.data());
+    }
+};
+
+/**
+ * Class GraphServer
+ * Event loop serving the commands of the program to many clients over a
+ * Unix domain socket or a loopback TCP port. Clients may pipeline requests:
+ * every complete line received is executed in order and the answers are
+ * written back in one batch. A client that stops reading its answers is not
+ * read from until they drain, and one that sends an endless line is dropped
+ */
+class GraphServer{
+public:
+    typedef function<void(const string&, istream&, ostream&)> Handler;
+
+    static const size_t LINE_LIMIT = 1 << 20;   // Longest incomplete line kept for a connection
+    static const size_t HIGH_WATER = 1 << 22;   // Unsent answers above which a connection is not read
+    static const size_t LOW_WATER = 1 << 21;    // Unsent answers below which it is read again
+
+private:
+    /**
+     * State of a client connection
+     */
+    struct Connection{
+        int socket;
+        RequestBuffer requests;
+        ReplyBuffer replies;
+        istream in;
+        ostream out;
+        bool writing = false;   // Whether the socket is watched for writability
+        bool closing = false;   // Whether the client finished sending
+        bool paused = false;    // Whether reading waits for the answers to drain
+        uint32_t watched = EPOLLIN;
+
+        explicit Connection(int socket): socket(socket), in(&requests), out(&replies){
+            replies.data.reserve(1 << 16);
+        }
+    };
+
+    Handler handler;                            // Executes one command
+    function<bool()> background;                // Runs deferred work, returns whether more is left
+    function<bool(ostream&)> owes;              // Whether answers are still owed to a connection
+    function<void(ostream&)> closed;            // Forgets the answers owed to a connection
+    int listener = -1;                          // Listening socket
+    int poller = -1;                            // Epoll instance
+    string path;                                // Path of the Unix socket, empty for TCP
+    unordered_map<int, unique_ptr<Connection>> connections;
+    string command;                             // Name of the command being executed
+
+    static volatile sig_atomic_t stopping;
+
+public:
+    /**
+     * Constructor with parameters
+     * @param handler Executes one command
+     * @param background Runs deferred work between events, returns whether more is left
+     * @param owes Determines whether deferred answers are owed to a connection
+     * @param closed Forgets the answers owed to a closed connection
+     */
+    explicit GraphServer(Handler handler, function<bool()> background = nullptr,
+                         function<bool(ostream&)> owes = nullptr, function<void(ostream&)> closed = nullptr)
+        : handler(handler), background(background), owes(owes), closed(closed){}
+
+    ~GraphServer(){
+        for (auto& connection : connections)
+            ::close(connection.first);
+        if (listener != -1)
+            ::close(listener);
+        if (poller != -1)
+            ::close(poller);
+        if (!path.empty())
+            unlink(path.c_str());
+    }
+
+    /**
+     * Method that opens a socket to an address
+     * @param address Port on the loopback interface if numeric, otherwise path of a Unix socket
+     * @param listening Whether to listen on the address instead of connecting to it
+     * @return Descriptor of the socket, -1 on failure
+     */
+    static int open(const string& address, bool listening){
+        bool tcp = !address.empty() && all_of(address.begin(), address.end(), ::isdigit);
+        int s = socket(tcp ? AF_INET : AF_UNIX, SOCK_STREAM, 0);
+        if (s == -1)
+            return -1;
+
+        sockaddr_storage storage = {};
+        socklen_t length;
+        if (tcp){
+            auto* inet = (sockaddr_in*) &storage;
+            inet->sin_family = AF_INET;
+            inet->sin_port = htons(stoi(address));
+            inet->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            length = sizeof(sockaddr_in);
+            int on = 1;
+            setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+            if (listening)
+                setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        }
+        else{
+            auto* local = (sockaddr_un*) &storage;
+            local->sun_family = AF_UNIX;
+            strncpy(local->sun_path, address.c_str(), sizeof(local->sun_path) - 1);
+            length = sizeof(sockaddr_un);
+            if (listening)
+                unlink(address.c_str());
+        }
+
+        bool ok = listening ? bind(s, (sockaddr*) &storage, length) == 0 && ::listen(s, SOMAXCONN) == 0
+                            : connect(s, (sockaddr*) &storage, length) == 0;
+        if (!ok){
+            ::close(s);
+            return -1;
+        }
+        return s;
+    }
+
+    /**
+     * Method that starts listening
+     * @param address Port on the loopback interface or path of a Unix socket
+     * @return Whether the server listens
+     */
+    bool listen(const string& address){
+        listener = open(address, true);
+        if (listener == -1)
+            return false;
+        if (!all_of(address.begin(), address.end(), ::isdigit))
+            path = address;
+        fcntl(listener, F_SETFL, O_NONBLOCK);
+
+        poller = epoll_create1(0);
+        watch(listener, EPOLLIN, EPOLL_CTL_ADD);
+        return true;
+    }
+
+    /**
+     * Method that serves clients until the process receives SIGINT or SIGTERM
+     */
+    void run(){
+        struct sigaction action = {};
+        action.sa_handler = [](int){ stopping = 1; };
+        sigaction(SIGINT, &action, nullptr);
+        sigaction(SIGTERM, &action, nullptr);
+        signal(SIGPIPE, SIG_IGN);
+
+        epoll_event events[64];
+        bool busy = false;
+        while (!stopping){
+            int ready = epoll_wait(poller, events, 64, busy ? 0 : -1);
+            for (int i = 0; i < ready; i++){
+                int s = events[i].data.fd;
+                if (s == listener){
+                    accept();
+                    continue;
+                }
+                auto found = connections.find(s);
+                if (found == connections.end())
+                    continue;
+                Connection& connection = *found->second;
+                bool open = !(connection.closing && events[i].events & (EPOLLHUP | EPOLLERR));
+                if (open && !connection.closing && events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                    open = receive(connection);
+                if (open)
+                    open = flush(connection);
+                if (!open || answered(connection))
+                    drop(s);
+            }
+
+            if (background){
+                busy = background();
+                vector<int> finished;
+                for (auto& connection : connections)
+                    if (connection.second->replies.data.size() > connection.second->replies.sent
+                        && (!flush(*connection.second) || answered(*connection.second)))
+                        finished.push_back(connection.first);
+                for (int s : finished)
+                    drop(s);
+            }
+        }
+    }
+
+private:
+    void watch(int s, uint32_t events, int operation){
+        epoll_event event = {};
+        event.events = events;
+        event.data.fd = s;
+        epoll_ctl(poller, operation, s, &event);
+    }
+
+    /**
+     * Method that watches a connection for the events its state calls for
+     * @param connection Connection
+     */
+    void rewatch(Connection& connection){
+        uint32_t events = 0;
+        if (!connection.closing && !connection.paused)
+            events |= EPOLLIN;
+        if (connection.writing)
+            events |= EPOLLOUT;
+        if (events != connection.watched)
+            watch(connection.socket, events, EPOLL_CTL_MOD);
+        connection.watched = events;
+    }
+
+    void accept(){
+        int s;
+        while ((s = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK)) != -1){
+            int on = 1;
+            setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+            connections[s] = unique_ptr<Connection>(new Connection(s));
+            watch(s, EPOLLIN, EPOLL_CTL_ADD);
+        }
+    }
+
+    /**
+     * Method that determines whether a client that finished sending got every answer
+     * @param connection Connection
+     * @return Whether the connection can be dropped
+     */
+    bool answered(Connection& connection){
+        return connection.closing && !connection.writing && !(owes && owes(connection.out));
+    }
+
+    void drop(int s){
+        if (closed)
+            closed(connections[s]->out);
+        epoll_ctl(poller, EPOLL_CTL_DEL, s, nullptr);
+        ::close(s);
+        connections.erase(s);
+    }
+
+    /**
+     * Method that reads everything available and executes the complete lines
+     * @param connection Connection
+     * @return Whether the connection is still open
+     */
+    bool receive(Connection& connection){
+        RequestBuffer& requests = connection.requests;
+        while (!connection.paused){
+            if (requests.used >= LINE_LIMIT)
+                return false;
+            if (requests.used == requests.data.size())
+                requests.data.resize(2 * requests.data.size());
+            ssize_t done = read(connection.socket, requests.data.data() + requests.used,
+                                requests.data.size() - requests.used);
+            if (done < 0)
+                return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+            requests.used += done;
+            // The bytes after the last newline are a final line once the client finished sending
+            if (done == 0 && requests.used > 0)
+                requests.data[requests.used++] = '\n';
+
+            if (requests.expose()){
+                connection.in.clear();
+                while (connection.in >> command)
+                    handler(command, connection.in, connection.out);
+                requests.consume();
+                if (!flush(connection))
+                    return false;
+            }
+            if (done == 0){
+                connection.closing = true;
+                rewatch(connection);
+                return true;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Method that writes pending answers, watching for writability while
+     * the socket cannot take them all and pausing reading while too many wait
+     * @param connection Connection
+     * @return Whether the connection is still open
+     */
+    bool flush(Connection& connection){
+        ReplyBuffer& replies = connection.replies;
+        connection.writing = false;
+        while (replies.sent < replies.data.size()){
+            ssize_t done = send(connection.socket, replies.data.data() + replies.sent,
+                                replies.data.size() - replies.sent, MSG_NOSIGNAL);
+            if (done < 0){
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                    return false;
+                connection.writing = true;
+                break;
+            }
+            replies.sent += done;
+        }
+
+        // Sent answers are dropped once they are half of the buffer, so it stays near the high water mark
+        if (replies.sent == replies.data.size() || replies.sent > replies.data.size() / 2){
+            replies.data.erase(replies.data.begin(), replies.data.begin() + replies.sent);
+            replies.sent = 0;
+        }
+        if (replies.data.size() > HIGH_WATER)
+            connection.paused = true;
+        else if (replies.data.size() < LOW_WATER)
+            connection.paused = false;
+        rewatch(connection);
         return true;
     }
+};
 
+volatile sig_atomic_t GraphServer::stopping = 0;
+
+/**
+ * Options of the program given on the command line
+ */
+struct Options{
+    string wal;                     // Directory of the write-ahead log, empty to keep the graph in memory only
+    WriteAheadLog<int>::Durability durability = WriteAheadLog<int>::GROUP;
+    int group = 64;                 // Records per fsync in group durability
+    long long checkpointEvery = 100000;     // Records between checkpoints, 0 to never checkpoint
+    string listen;                  // Address to serve commands on instead of the standard input
+    string load;                    // Address of a server to generate load against
+    int connections = 4;            // Client connections of the load generator
+    long long requests = 100000;    // Requests sent by the load generator
+    int depth = 16;                 // Requests in flight per connection
+    int vertices = 1000;            // Vertices of the generated graph
+    int writes = 10;                // Percentage of requests that add an edge
+    long long slice = 4096;         // Search steps of an ASYNC query between other commands
+    bool edgeFilter = false;        // Whether HAS_EDGE asks a cuckoo filter before the matrix
+    int threads = 1;                // Threads answering runs of read-only commands from the standard input
 };
 
 /**
  * Method that solves current problem
+ * @param options Command line options
  */
-void solve(){
-    typedef string V;
+void solve(const Options& options){
+    typedef uint32_t V;
     typedef int E;
+    typedef GraphBatch<V, E> Batch;
+    typedef WriteAheadLog<E> Log;
 
     AdjacencyMatrixGraph<V, E> graph;
+    SymbolTable symbols;    // Titles of the vertices, the graph only sees their identifiers
+    GraphBatch<V, E> batch; // Mutations staged since BEGIN
+    bool transaction = false;
+    PersistentGraph<E> head;                // Version of the graph after the last applied mutation
+    map<string, PersistentGraph<E>> tags;   // Versions kept by TAG
+    Log log;
+    QueryExecutor executor(options.slice);  // Queries started by ASYNC
+
+    // Applies or stages one mutation command, shared by the parser and the log replay
+    auto mutate = [&](int type, string_view from, string_view to, E weight){
+        if (log.isOpen())
+            log.append(type, from, to, weight);
+
+        if (type == Log::BEGIN){
+            transaction = true;
+        }
+        else if (type == Log::COMMIT){
+            for (auto& operation : batch.operations)
+                head.apply(operation.type, operation.from, operation.to, operation.weight);
+            graph.apply(batch);
+            transaction = false;
+        }
+        else if (type == Log::ROLLBACK){
+            batch.clear();
+            transaction = false;
+        }
+        else if (type == Batch::ADD_VERTEX){
+            if (transaction)
+                batch.addVertex(symbols.intern(from));
+            else{
+                graph.addVertex(symbols.intern(from));
+                head.addVertex(symbols.find(from));
+            }
+        }
+        else if (type == Batch::REMOVE_VERTEX){
+            Vertex<V> vertex(symbols.find(from));
+            if (transaction && vertex.title != SymbolTable::NONE)
+                batch.removeVertex(vertex.title);
+            else if (!transaction && graph.getIndex(&vertex) != -1){
+                graph.removeVertex(&vertex);
+                head.removeVertex(vertex.title);
+            }
+        }
+        else if (type == Batch::ADD_EDGE){
+            Vertex<V> fromVertex(symbols.intern(from));
+            Vertex<V> toVertex(symbols.intern(to));
+            if (transaction)
+                batch.addEdge(fromVertex.title, toVertex.title, weight);
+            else{
+                // The version records the cell the matrix wrote, even for a missing endpoint
+                Edge<E>* edge = graph.addEdge(&fromVertex, &toVertex, weight);
+                head.addEdge(graph.vertices[edge->from]->title, graph.vertices[edge->to]->title, weight);
+            }
+        }
+        else if (type == Batch::REMOVE_EDGE){
+            Vertex<V> fromVertex(symbols.find(from));
+            Vertex<V> toVertex(symbols.find(to));
+            if (transaction && fromVertex.title != SymbolTable::NONE && toVertex.title != SymbolTable::NONE)
+                batch.removeEdge(fromVertex.title, toVertex.title);
+            else if (!transaction && graph.hasEdge(&fromVertex, &toVertex)){
+                graph.removeEdge(graph.findEdge(fromVertex.title, toVertex.title));
+                head.removeEdge(fromVertex.title, toVertex.title);
+            }
+        }
+        else if (type == Batch::TRANSPOSE){
+            if (transaction)
+                batch.transpose();
+            else{
+                graph.transpose();
+                head.transpose();
+            }
+        }
+
+        // Traversals in flight cannot follow a change of the graph
+        if (!transaction && type != Log::BEGIN && type != Log::ROLLBACK)
+            executor.cancelAll();
+
+        if (log.isOpen() && !transaction && options.checkpointEvery > 0 && log.records >= options.checkpointEvery)
+            log.checkpoint(graph, symbols);
+    };
+
+    graph.useFilter(options.edgeFilter);
+    if (!options.wal.empty()){
+        auto started = chrono::steady_clock::now();
+        log.configure(options.wal, options.durability, options.group);
+        long long replayed = log.recover(graph, symbols, [&](const Log::Record& record){
+            mutate(record.type, record.from, record.to, record.weight);
+        });
+        double elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+        cerr << "recovered " << graph.vertices.size() << " vertices, replayed " << replayed
+             << " log records in " << elapsed << " ms" << endl;
+        head.assign(graph);
+        if (options.checkpointEvery > 0 && log.records >= options.checkpointEvery)
+            log.checkpoint(graph, symbols);
+    }
+
+    const map<string, int> mutations = {
+        {"BEGIN", Log::BEGIN}, {"COMMIT", Log::COMMIT}, {"ROLLBACK", Log::ROLLBACK},
+        {"ADD_VERTEX", Batch::ADD_VERTEX}, {"REMOVE_VERTEX", Batch::REMOVE_VERTEX},
+        {"ADD_EDGE", Batch::ADD_EDGE}, {"REMOVE_EDGE", Batch::REMOVE_EDGE}, {"TRANSPOSE", Batch::TRANSPOSE}
+    };
+
+    // Answer of IS_ACYCLIC, the length and the vertices of the cycle or ACYCLIC
+    auto printCycle = [&](const vector<int>& cycle, ostream& out){
+        if (!cycle.empty()){
+            E distance = 0;
+            for (int j = 0; j < cycle.size(); j++)
+                distance+= graph.edges[cycle[j]][cycle[(j+1)%cycle.size()]]->weight;
+
+            out << distance << " ";
+            for (int v : cycle)
+                out << symbols.title(graph.vertices[v]->title) << " ";
+        }
+        else{
+            out << "ACYCLIC";
+        }
+        out <<  endl;
+    };
 
-    string cmd;
+    // Builds a traversal query that can run at once or in slices, reading its arguments from in
+    auto longQuery = [&](const string& cmd, istream& in) -> QueryExecutor::Query {
+        if (cmd == "IS_ACYCLIC"){
+            auto search = make_shared<AcyclicitySearch<V, E>>(graph);
+            return [&, search](long long budget, ostream& out){
+                search->budget = budget;
+                if (!search->resume())
+                    return false;
+                printCycle(search->cycle, out);
+                return true;
+            };
+        }
+
+        typedef pair<E, vector<int>> Cycle;
+        struct Enumeration{
+            CycleEnumerator<V, E> enumerator;
+            priority_queue<Cycle, vector<Cycle>, greater<Cycle>> heaviest;
+            int found;
+        };
+        int count, length;
+        E limit;
+        in >> count >> length >> limit;
+        auto state = make_shared<Enumeration>(Enumeration{CycleEnumerator<V, E>(graph, length, limit), {}, 0});
+        bool streamed = cmd == "CYCLES";
+
+        return [&, state, streamed, count](long long budget, ostream& out){
+            auto print = [&](const vector<int>& cycle, E total){
+                out << total;
+                for (int v : cycle)
+                    out << " " << symbols.title(graph.vertices[v]->title);
+                out << '\n';
+            };
+
+            // Cycles are streamed as they are found, only the k heaviest are ever held
+            auto& heaviest = state->heaviest;
+            vector<int> cycle;
+            E weight;
+            state->enumerator.budget = budget;
+            while (state->enumerator.next(cycle, weight)){
+                state->found++;
+                if (streamed){
+                    print(cycle, weight);
+                    if (state->found == count) break;
+                }
+                else if (count <= 0 || heaviest.size() < count || weight > heaviest.top().first){
+                    heaviest.push({weight, cycle});
+                    if (count > 0 && heaviest.size() > count)
+                        heaviest.pop();
+                }
+            }
+            bool enough = streamed && count > 0 && state->found == count;
+            if (!enough && !state->enumerator.finished)
+                return false;
+
+            vector<Cycle> top;
+            for (; !heaviest.empty(); heaviest.pop())
+                top.push_back(heaviest.top());
+            for (int j = top.size() - 1; j >= 0; j--)
+                print(top[j].second, top[j].first);
+            if (state->found == 0)
+                out << "ACYCLIC" << '\n';
+            out.flush();
+            return true;
+        };
+    };
+
+    // Executes one command, reading its arguments from in and writing its answer to out
+    string from, to;
     int weight = 0;
-    while (cin >> cmd){
-
-        if (cmd == "ADD_VERTEX"){
-            string title;
-            cin >> title;
-            graph.addVertex(title);
-        }
-        else if (cmd == "REMOVE_VERTEX"){
-            string title;
-            cin >> title;
-            auto vertex = new Vertex<V>(title);
-            graph.removeVertex(vertex);
-        }
-        else if (cmd == "ADD_EDGE"){
-            string from, to;
-            cin >> from >> to >> weight;
-            auto fromVertex = new Vertex<V>(from);
-            auto toVertex = new Vertex<V>(to);
-            graph.addEdge(fromVertex, toVertex, weight);
-        }
-        else if (cmd == "REMOVE_EDGE"){
-            string from, to;
-            cin >> from >> to;
-            graph.removeEdge(graph.findEdge(from, to));
+    string tracePath;               // Chrome trace of the explained queries, empty for none
+    vector<string> traceEvents;
+    int sccThreads = max(1u, thread::hardware_concurrency());
+    function<void(const string&, istream&, ostream&)> execute;
+    execute = [&](const string& cmd, istream& in, ostream& out){
+
+        auto mutation = mutations.find(cmd);
+        if (mutation != mutations.end()){
+            int type = mutation->second;
+            from.clear();
+            to.clear();
+            weight = 0;
+            if (type == Batch::ADD_VERTEX || type == Batch::REMOVE_VERTEX)
+                in >> from;
+            else if (type == Batch::ADD_EDGE)
+                in >> from >> to >> weight;
+            else if (type == Batch::REMOVE_EDGE)
+                in >> from >> to;
+            mutate(type, from, to, weight);
         }
         else if (cmd == "HAS_EDGE"){
-            string from, to;
-            cin >> from >> to;
-            auto fromVertex = new Vertex<V>(from);
-            auto toVertex = new Vertex<V>(to);
-            if (graph.hasEdge(fromVertex, toVertex))
-                cout << "TRUE" << endl;
+            string from, to;        // Read-only commands may run concurrently and keep their arguments local
+            in >> from >> to;
+            Vertex<V> fromVertex(symbols.find(from));
+            Vertex<V> toVertex(symbols.find(to));
+            if (graph.hasEdge(&fromVertex, &toVertex))
+                out << "TRUE" << endl;
+            else
+                out << "FALSE" << endl;
+        }
+        else if (cmd == "IS_ACYCLIC" || cmd == "CYCLES" || cmd == "TOP_CYCLES"){
+            longQuery(cmd, in)(-1, out);
+        }
+        else if (cmd == "DEGREE"){
+            string name;
+            in >> name;
+            Vertex<V> vertex(symbols.find(name));
+            int index = graph.getIndex(&vertex);
+            if (index == -1)
+                out << "UNKNOWN_VERTEX" << endl;
             else
-                cout << "FALSE" << endl;
+                out << graph.outDegree(index) << " " << graph.inDegree(index) << endl;
+        }
+        else if (cmd == "COUNT" || cmd == "SUMMARY"){
+            out << graph.vertices.size() << " " << graph.edgeCount() << " " << graph.totalWeight() << endl;
+            if (cmd == "COUNT") return;
+            for (bool incoming : {false, true}){
+                const vector<int>& histogram = graph.degreeHistogram(incoming);
+                out << (incoming ? "IN" : "OUT");
+                for (int degree = 0; degree < histogram.size(); degree++)
+                    if (histogram[degree])
+                        out << " " << degree << ":" << histogram[degree];
+                out << endl;
+            }
         }
-        else if (cmd == "TRANSPOSE"){
-            graph.transpose();
+        else if (cmd == "ASYNC"){
+            string id, query;
+            long long timeout;
+            in >> id >> timeout >> query;
+            if (query == "IS_ACYCLIC" || query == "CYCLES" || query == "TOP_CYCLES")
+                executor.submit(id, out, timeout, longQuery(query, in));
+            else{
+                ostringstream answer;
+                execute(query, in, answer);
+                QueryExecutor::respond(id, out, answer.str());
+            }
+        }
+        else if (cmd == "CANCEL"){
+            string id;
+            in >> id;
+            executor.cancel(id);
+        }
+        else if (cmd == "EXPLAIN"){
+            string query;
+            in >> query;
+            QueryProfile profile;
+            if (query == "IS_ACYCLIC"){
+                profile.phase("prepare");
+                AcyclicitySearch<V, E, QueryProfile> search(graph, profile);
+                profile.phase("search");
+                search.resume();
+                profile.phase("print");
+                printCycle(search.cycle, out);
+            }
+            else{
+                // Other commands are only timed
+                profile.phase("query");
+                execute(query, in, out);
+            }
+            profile.report(out);
+            if (!tracePath.empty()){
+                profile.trace(traceEvents, query);
+                QueryProfile::writeTrace(tracePath, traceEvents);
+            }
         }
-        else if (cmd == "IS_ACYCLIC"){
-            vector<Vertex<V>*> stack = vector<Vertex<V>*>(0);
-            if (!graph.isAcyclic( stack)){
-                string order;
-                E distance = 0;
+        else if (cmd == "TRACE"){
+            in >> tracePath;
+            if (tracePath == "-")
+                tracePath.clear();
+            traceEvents.clear();
+        }
+        else if (cmd == "EDGE_FILTER"){
+            string state;
+            in >> state;
+            graph.useFilter(state == "on");
+        }
+        else if (cmd == "EDGE_FILTER_BENCH"){
+            long long probes;
+            in >> probes;
+            int n = graph.vertices.size();
+            if (n == 0) return;
+            mt19937 random(1);
+            vector< pair<Vertex<V>, Vertex<V>> > pairs;
+            for (int i = 0; i < 4096; i++)
+                pairs.push_back({Vertex<V>(graph.vertices[random() % n]->title), Vertex<V>(graph.vertices[random() % n]->title)});
 
-                for (int j = 0; j < stack.size(); j++){
-                    order+= stack[j]->title + " ";
-                    distance+= graph.edges[graph.getIndex(stack[j%stack.size()])][graph.getIndex(stack[(j+1)%stack.size()])]->weight;
+            bool enabled = graph.filter.enabled;
+            for (bool on : {false, true}){
+                graph.useFilter(on);
+                long long found = 0;
+                auto started = chrono::steady_clock::now();
+                for (long long i = 0; i < probes; i++){
+                    auto& probe = pairs[i & 4095];
+                    found += graph.hasEdge(&probe.first, &probe.second);
                 }
+                double elapsed = chrono::duration<double, nano>(chrono::steady_clock::now() - started).count();
+                out << (on ? "filter " : "matrix ") << elapsed / max(probes, 1LL) << " ns " << found << " found" << endl;
+            }
+            graph.useFilter(enabled);
+        }
+        else if (cmd == "STATS"){
+            EdgeFilter& filter = graph.filter;
+            if (!filter.enabled){
+                out << "EDGE_FILTER off" << endl;
+                return;
+            }
+            long long absent = filter.rejected + filter.falsePositives;
+            out << "EDGE_FILTER on bytes " << filter.bytes() << " keys " << filter.size() << " load " << filter.load()
+                << " expected_fpr " << filter.expectedFalsePositives() << " lookups " << filter.lookups.load()
+                << " rejected " << filter.rejected.load() << " false_positives " << filter.falsePositives.load()
+                << " observed_fpr " << (absent ? (double) filter.falsePositives / absent : 0) << endl;
+        }
+        else if (cmd == "TAG"){
+            string name;
+            in >> name;
+            tags[name] = head;
+        }
+        else if (cmd == "UNTAG"){
+            string name;
+            in >> name;
+            tags.erase(name);
+        }
+        else if (cmd == "TAGS"){
+            for (auto& tag : tags)
+                out << tag.first << " " << tag.second.vertexCount() << " " << tag.second.edgeCount() << endl;
+        }
+        else if (cmd == "AT" || cmd == "SHORTEST_PATH"){
+            string name = "HEAD", query = cmd, from, to;
+            if (cmd == "AT")
+                in >> name >> query;
+            if (query == "HAS_EDGE" || query == "SHORTEST_PATH")
+                in >> from >> to;
+            auto tag = tags.find(name);
+            if (name != "HEAD" && tag == tags.end()){
+                out << "UNKNOWN_TAG" << endl;
+                return;
+            }
+            const PersistentGraph<E>& version = name == "HEAD" ? head : tag->second;
+            uint32_t source = symbols.find(from), target = symbols.find(to);
+            vector<uint32_t> titles;
+            E length = 0;
 
-                int n = order.length();
-                char char_array[n + 1];
-                strcpy(char_array, order.c_str());
-                cout << distance << " " << char_array;
+            if (query == "HAS_EDGE"){
+                out << (version.hasEdge(source, target) ? "TRUE" : "FALSE") << endl;
+                return;
             }
+            else if (query == "IS_ACYCLIC"){
+                titles = version.findCycle();
+                for (int j = 0; j < titles.size(); j++)
+                    length += *version.weight(titles[j], titles[(j + 1) % titles.size()]);
+            }
+            else if (query == "SHORTEST_PATH")
+                length = version.shortestPath(source, target, titles);
+
+            if (titles.empty())
+                out << (query == "IS_ACYCLIC" ? "ACYCLIC" : "UNREACHABLE");
             else{
-                cout << "ACYCLIC";
+                out << length << " ";
+                for (uint32_t title : titles)
+                    out << symbols.title(title) << " ";
+            }
+            out << endl;
+        }
+        else if (cmd == "PARALLEL_ACYCLIC"){
+            ParallelComponents<V, E> engine;
+            engine.build(graph);
+            engine.run(sccThreads);
+            printCycle(engine.witness(), out);
+        }
+        else if (cmd == "SCC"){
+            ParallelComponents<V, E> engine;
+            engine.build(graph);
+            int count = engine.run(sccThreads);
+
+            // Components by their first vertex, members in index order
+            vector< vector<int> > members(count);
+            for (int v = 0; v < graph.vertices.size(); v++)
+                members[engine.component[v]].push_back(v);
+            sort(members.begin(), members.end());
+            out << count << endl;
+            for (auto& component : members){
+                out << component.size();
+                for (int v : component)
+                    out << " " << symbols.title(graph.vertices[v]->title);
+                out << endl;
             }
-            cout <<  endl;
+        }
+        else if (cmd == "SCC_THREADS"){
+            in >> sccThreads;
+            sccThreads = max(sccThreads, 1);
+        }
+        else if (cmd == "SCC_BENCH"){
+            auto time = [](const function<void()>& body){
+                auto started = chrono::steady_clock::now();
+                body();
+                return chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+            };
+            bool acyclic = false;
+            size_t tarjan = 0;
+            double elapsed = time([&](){
+                AcyclicitySearch<V, E> search(graph);
+                search.resume();
+                acyclic = search.cycle.empty();
+            });
+            out << "dfs " << elapsed << " ms " << (acyclic ? "ACYCLIC" : "CYCLIC") << endl;
+            elapsed = time([&](){ tarjan = graph.stronglyConnectedComponents().size(); });
+            out << "tarjan " << elapsed << " ms " << tarjan << " components" << endl;
+
+            ParallelComponents<V, E> engine;
+            elapsed = time([&](){ engine.build(graph); });
+            out << "snapshot " << elapsed << " ms" << endl;
+            for (int threads = 1; threads <= sccThreads; threads *= 2){
+                int count = 0;
+                elapsed = time([&](){ count = engine.run(threads); });
+                out << "parallel " << threads << " threads " << elapsed << " ms " << count << " components "
+                    << engine.trimmed << " trimmed " << engine.steals << " steals" << endl;
+            }
+        }
+    };
+
+    if (!options.listen.empty()){
+        GraphServer server(execute, [&](){ return executor.run(); },
+                           [&](ostream& out){ return executor.owes(out); }, [&](ostream& out){ executor.forget(out); });
+        if (!server.listen(options.listen)){
+            cerr << "cannot listen on " << options.listen << endl;
+            return;
+        }
+        server.run();
+        return;
+    }
 
+    if (options.threads > 1){
+        // Read-only commands, with the number of arguments each reads
+        const map<string, int> reads = {
+            {"HAS_EDGE", 2}, {"IS_ACYCLIC", 0}, {"CYCLES", 3}, {"TOP_CYCLES", 3}, {"SHORTEST_PATH", 2},
+            {"AT", 2}, {"TAGS", 0}, {"SCC", 0}, {"PARALLEL_ACYCLIC", 0}, {"DEGREE", 1}, {"COUNT", 0}, {"SUMMARY", 0}
+        };
+        auto arguments = [&](const string& cmd, istream& in, string& read){
+            auto command = reads.find(cmd);
+            if (command == reads.end())
+                return false;
+            read.clear();
+            string token;
+            for (int i = 0; i < command->second && in >> token; i++){
+                read += token + " ";
+                if (cmd == "AT" && i == 1 && (token == "HAS_EDGE" || token == "SHORTEST_PATH"))
+                    for (int j = 0; j < 2 && in >> token; j++)
+                        read += token + " ";
+            }
+            graph.refreshPositions();
+            return true;
+        };
+        OrderedExecutor ordered(options.threads, execute, arguments);
+        ordered.run(cin, cout, [&](){ return executor.idle(); }, [&](){ executor.run(); });
+    }
+    else{
+        string cmd;
+        while (cin >> cmd){
+            execute(cmd, cin, cout);
+            executor.run();
         }
+    }
+    while (executor.run());
+}
 
+/**
+ * Method that loads a running server and reports its throughput and latency.
+ * Every request is either HAS_EDGE or an ADD_EDGE followed by HAS_EDGE of the same edge
+ * @param options Command line options
+ */
+void generateLoad(const Options& options){
+    int setup = GraphServer::open(options.load, false);
+    if (setup == -1){
+        cerr << "cannot connect to " << options.load << endl;
+        return;
     }
+    string batch;
+    for (int v = 0; v < options.vertices; v++)
+        batch += "ADD_VERTEX v" + to_string(v) + "\n";
+    batch += "HAS_EDGE v0 v0\n";
+    write(setup, batch.data(), batch.size());
+    char byte;
+    while (read(setup, &byte, 1) == 1 && byte != '\n');
+    close(setup);
+
+    typedef chrono::steady_clock Clock;
+    int connections = max(options.connections, 1);
+    vector< vector<double> > latencies(connections);
+    vector<thread> clients;
+    auto started = Clock::now();
 
+    for (int c = 0; c < connections; c++)
+        clients.emplace_back([&, c](){
+            int s = GraphServer::open(options.load, false);
+            if (s == -1)
+                return;
+            long long quota = options.requests / connections + (c < options.requests % connections);
+            latencies[c].reserve(quota);
+            vector<Clock::time_point> issued(options.depth);    // Ring of send times of requests in flight
+            mt19937 random(c);
+            long long sent = 0, answered = 0;
+            string requests;
+            char replies[1 << 16];
+
+            while (answered < quota){
+                requests.clear();
+                for (; sent < quota && sent - answered < options.depth; sent++){
+                    string from = "v" + to_string(random() % options.vertices);
+                    string to = "v" + to_string(random() % options.vertices);
+                    if (random() % 100 < options.writes)
+                        requests += "ADD_EDGE " + from + " " + to + " " + to_string(random() % 100) + "\n";
+                    requests += "HAS_EDGE " + from + " " + to + "\n";
+                    issued[sent % options.depth] = Clock::now();
+                }
+                if (!requests.empty() && send(s, requests.data(), requests.size(), MSG_NOSIGNAL) != requests.size())
+                    break;
+
+                ssize_t done = read(s, replies, sizeof(replies));
+                if (done <= 0)
+                    break;
+                auto now = Clock::now();
+                for (ssize_t i = 0; i < done; i++)
+                    if (replies[i] == '\n'){
+                        latencies[c].push_back(chrono::duration<double, micro>(now - issued[answered % options.depth]).count());
+                        answered++;
+                    }
+            }
+            close(s);
+        });
+    for (auto& client : clients)
+        client.join();
+    double elapsed = chrono::duration<double>(Clock::now() - started).count();
+
+    vector<double> all;
+    for (auto& part : latencies)
+        all.insert(all.end(), part.begin(), part.end());
+    sort(all.begin(), all.end());
+    auto percentile = [&](double p){
+        return all.empty() ? 0.0 : all[min(all.size() - 1, (size_t) (p * all.size()))];
+    };
+
+    cout << "requests " << all.size() << " connections " << connections << " depth " << options.depth
+         << " seconds " << elapsed << endl;
+    cout << "qps " << all.size() / elapsed << endl;
+    cout << "latency_us p50 " << percentile(0.5) << " p90 " << percentile(0.9) << " p99 " << percentile(0.99)
+         << " p99.9 " << percentile(0.999) << " max " << (all.empty() ? 0.0 : all.back()) << endl;
 }
 
 // Drive the code
-int main()
+int main(int argc, char* argv[])
 {
-    solve();
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2){
+        string flag = argv[i], value = argv[i + 1];
+        if (flag == "--wal")
+            options.wal = value;
+        else if (flag == "--durability")
+            options.durability = value == "none" ? WriteAheadLog<int>::NONE
+                                 : value == "full" ? WriteAheadLog<int>::FULL : WriteAheadLog<int>::GROUP;
+        else if (flag == "--group")
+            options.group = stoi(value);
+        else if (flag == "--checkpoint")
+            options.checkpointEvery = stoll(value);
+        else if (flag == "--listen")
+            options.listen = value;
+        else if (flag == "--load")
+            options.load = value;
+        else if (flag == "--connections")
+            options.connections = stoi(value);
+        else if (flag == "--requests")
+            options.requests = stoll(value);
+        else if (flag == "--depth")
+            options.depth = max(stoi(value), 1);
+        else if (flag == "--vertices")
+            options.vertices = max(stoi(value), 1);
+        else if (flag == "--writes")
+            options.writes = stoi(value);
+        else if (flag == "--slice")
+            options.slice = stoll(value);
+        else if (flag == "--edge-filter")
+            options.edgeFilter = value == "on";
+        else if (flag == "--threads")
+            options.threads = max(stoi(value), 1);
+    }
+    if (options.threads > 1)
+        ios::sync_with_stdio(false);    // Lets the reader see how much input is already buffered
+    if (!options.load.empty())
+        generateLoad(options);
+    else
+        solve(options);
     return 0;
 }
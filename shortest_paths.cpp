@@ -10,7 +10,28 @@
 #include <string>
 #include <type_traits>
 #include <cstring>
+#include <climits>
 #include <queue>
+#include <map>
+#include <set>
+#include <limits>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <immintrin.h>
 using namespace std;
 
 /**
@@ -41,6 +62,8 @@ public:
     T weight;   // Weight of the  Edge
     T bandwidth;   // Weight of the  Edge
     bool isEmpty;
+    int from = -1;  // Index of the source vertex
+    int to = -1;    // Index of the target vertex
 
     Edge(){
         this->isEmpty = true;
@@ -57,6 +80,577 @@ public:
     }
 };
 
+/**
+ * Class NeighbourRange
+ * View over the non-empty cells of one row or column of an adjacency
+ * matrix, yielding the index of the neighbour and the edge without allocating
+ * @tparam T Type of the weight
+ */
+template<typename T>
+class NeighbourRange{
+    const vector< vector<Edge<T>*> >& edges;   // Adjacency matrix
+    int line;                                   // Index of the row or column
+    bool incoming;                              // Whether the view walks a column
+
+public:
+    class iterator{
+        const NeighbourRange* range;
+        int index;
+
+        void skip(){
+            while (index < range->edges.size() && range->cell(index)->isEmpty)
+                index++;
+        }
+
+    public:
+        iterator(const NeighbourRange* range, int index) : range(range), index(index){
+            skip();
+        }
+        pair<int, Edge<T>*> operator*() const{
+            return {index, range->cell(index)};
+        }
+        iterator& operator++(){
+            index++;
+            skip();
+            return *this;
+        }
+        bool operator!=(const iterator& other) const{
+            return index != other.index;
+        }
+    };
+
+    /**
+     * Constructor with parameters
+     * @param edges Adjacency matrix
+     * @param line Index of the row or column
+     * @param incoming Whether to walk the column instead of the row
+     */
+    NeighbourRange(const vector< vector<Edge<T>*> >& edges, int line, bool incoming)
+        : edges(edges), line(line), incoming(incoming){}
+
+    Edge<T>* cell(int i) const{
+        return incoming ? edges[i][line] : edges[line][i];
+    }
+
+    iterator begin() const{
+        return iterator(this, 0);
+    }
+
+    iterator end() const{
+        return iterator(this, edges.size());
+    }
+};
+
+
+/**
+ * Struct NoProfile
+ * Profiling policy of plain queries, its hooks are empty and compile away
+ */
+struct NoProfile{
+    static const bool enabled = false;
+
+    void settle(){}
+    void scan(){}
+    void skip(){}
+    void push(size_t){}
+    void pop(size_t){}
+    void reach(int){}
+    void allocate(size_t){}
+    void phase(const char*){}
+};
+
+static NoProfile noProfile;             // Profile of the queries run without EXPLAIN
+
+/**
+ * Class QueryProfile
+ * Profiling policy of EXPLAIN, counting the work of one query and timing its phases
+ */
+class QueryProfile{
+public:
+    static const bool enabled = true;
+
+    long long settled = 0;              // Vertices settled or entered
+    long long scanned = 0;              // Edges examined
+    long long filtered = 0;             // Edges skipped for a bandwidth below W
+    long long pushes = 0;               // Pushes to the queue or the stack
+    long long pops = 0;                 // Pops from the queue or the stack
+    int depth = 0;                      // Longest depth-first path
+    long long allocated = 0;            // Bytes of the working arrays
+
+private:
+    typedef chrono::steady_clock Clock;
+
+    /**
+     * Timed part of the query
+     */
+    struct Phase{
+        string name;
+        Clock::time_point start;
+        double milliseconds;
+    };
+
+    vector<Phase> phases;
+    long long pending = 0;              // Bytes held by the queue or the stack
+    long long peak = 0;                 // Largest value of pending
+
+    static Clock::time_point origin(){
+        static Clock::time_point start = Clock::now();
+        return start;
+    }
+
+    static string quoted(const string& text){
+        string result = "\"";
+        for (char c : text){
+            if (c == '"' || c == '\\')
+                result += '\\';
+            result += c;
+        }
+        return result + "\"";
+    }
+
+public:
+    QueryProfile(){
+        origin();
+    }
+
+    void settle(){
+        settled++;
+    }
+
+    void scan(){
+        scanned++;
+    }
+
+    void skip(){
+        filtered++;
+    }
+
+    void push(size_t bytes){
+        pushes++;
+        pending += bytes;
+        peak = max(peak, pending);
+    }
+
+    void pop(size_t bytes){
+        pops++;
+        pending -= bytes;
+    }
+
+    void reach(int length){
+        depth = max(depth, length);
+    }
+
+    void allocate(size_t bytes){
+        allocated += bytes;
+    }
+
+    /**
+     * Method that ends the current phase and starts the next one
+     * @param name Name of the next phase, nullptr to only end the current one
+     */
+    void phase(const char* name){
+        Clock::time_point now = Clock::now();
+        if (!phases.empty() && phases.back().milliseconds < 0)
+            phases.back().milliseconds = chrono::duration<double, milli>(now - phases.back().start).count();
+        if (name)
+            phases.push_back({name, now, -1});
+    }
+
+    /**
+     * Method that prints the counters and the time of every phase
+     * @param out Output stream
+     */
+    void report(ostream& out){
+        phase(nullptr);
+        out << "EXPLAIN settled " << settled << " scanned " << scanned << " filtered " << filtered
+            << " pushes " << pushes << " pops " << pops << " depth " << depth << " bytes " << allocated + peak << endl;
+        for (auto& part : phases)
+            out << "PHASE " << part.name << " " << part.milliseconds << endl;
+    }
+
+    /**
+     * Method that appends the query and its phases as Chrome trace events
+     * @param events Events in JSON
+     * @param query Text of the query
+     */
+    void trace(vector<string>& events, const string& query){
+        phase(nullptr);
+        auto micros = [](Clock::time_point at){
+            return chrono::duration_cast<chrono::microseconds>(at - origin()).count();
+        };
+        if (phases.empty()) return;
+        long long start = micros(phases.front().start);
+        long long total = micros(phases.back().start) + (long long) (phases.back().milliseconds * 1000) - start;
+
+        ostringstream event;
+        event << "{\"name\":" << quoted(query) << ",\"cat\":\"query\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":" << start
+              << ",\"dur\":" << total << ",\"args\":{\"settled\":" << settled << ",\"scanned\":" << scanned
+              << ",\"filtered\":" << filtered << ",\"pushes\":" << pushes << ",\"pops\":" << pops
+              << ",\"depth\":" << depth << ",\"bytes\":" << allocated + peak << "}}";
+        events.push_back(event.str());
+        for (auto& part : phases){
+            event.str("");
+            event << "{\"name\":" << quoted(part.name) << ",\"cat\":\"phase\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":"
+                  << micros(part.start) << ",\"dur\":" << (long long) (part.milliseconds * 1000) << "}";
+            events.push_back(event.str());
+        }
+    }
+
+    /**
+     * Method that writes trace events as a file for chrome://tracing
+     * @param path Path of the file
+     * @param events Events in JSON
+     * @return Whether the file was written
+     */
+    static bool writeTrace(const string& path, const vector<string>& events){
+        ofstream file(path, ios::trunc);
+        file << "{\"traceEvents\":[";
+        for (size_t i = 0; i < events.size(); i++)
+            file << (i ? ",\n" : "\n") << events[i];
+        file << "\n]}" << endl;
+        return (bool) file;
+    }
+};
+
+/**
+ * Struct WeightTraits
+ * Compile-time properties of a weight type, choosing the priority queue of dijkstra
+ * @tparam T Type of the weight
+ */
+template<typename T>
+struct WeightTraits{
+    static const bool integral = is_integral<T>::value;    // Keys can index the bucket queue and the radix heap
+
+    /**
+     * Method that returns the distance of unreachable vertices
+     * @return Infinity where the type has one, its largest value otherwise
+     */
+    static T infinity(){
+        return numeric_limits<T>::has_infinity ? numeric_limits<T>::infinity() : numeric_limits<T>::max();
+    }
+};
+
+/**
+ * Class DaryHeap
+ * Implicit heap with D children per node, popping the least key and then the least vertex
+ * @tparam T Type of the key
+ * @tparam D Number of children
+ */
+template<typename T, int D>
+class DaryHeap{
+    vector< pair<T, int> > items;
+
+public:
+    bool empty() const{
+        return items.empty();
+    }
+
+    void push(T key, int vertex){
+        size_t i = items.size();
+        items.emplace_back(key, vertex);
+        while (i > 0 && items[i] < items[(i - 1) / D]){
+            swap(items[i], items[(i - 1) / D]);
+            i = (i - 1) / D;
+        }
+    }
+
+    pair<T, int> pop(){
+        pair<T, int> top = items[0];
+        items[0] = items.back();
+        items.pop_back();
+        for (size_t i = 0;;){
+            size_t least = i;
+            for (size_t child = i * D + 1; child <= i * D + D && child < items.size(); child++)
+                if (items[child] < items[least])
+                    least = child;
+            if (least == i) break;
+            swap(items[i], items[least]);
+            i = least;
+        }
+        return top;
+    }
+};
+
+/**
+ * Class BucketQueue
+ * Dial's queue for non-negative integer keys that never exceed the last popped
+ * key by more than the widest edge. Key k lives in bucket k modulo the number
+ * of buckets; the bucket being drained is kept as a heap of vertices so that
+ * equal keys pop by vertex, also when zero-length edges add to it
+ * @tparam T Type of the key
+ */
+template<typename T>
+class BucketQueue{
+    vector< vector<int> > buckets;
+    T current = 0;                      // Key of the bucket being drained
+    bool draining = false;              // Whether the current bucket is a heap
+    size_t count = 0;
+
+public:
+    /**
+     * Constructor with parameters
+     * @param widest Largest difference between a pushed key and the last popped one
+     */
+    explicit BucketQueue(T widest) : buckets((size_t) widest + 1){}
+
+    bool empty() const{
+        return count == 0;
+    }
+
+    void push(T key, int vertex){
+        vector<int>& bucket = buckets[key % buckets.size()];
+        bucket.push_back(vertex);
+        if (draining && key == current)
+            push_heap(bucket.begin(), bucket.end(), greater<int>());
+        count++;
+    }
+
+    pair<T, int> pop(){
+        while (buckets[current % buckets.size()].empty()){
+            current++;
+            draining = false;
+        }
+        vector<int>& bucket = buckets[current % buckets.size()];
+        if (!draining){
+            make_heap(bucket.begin(), bucket.end(), greater<int>());
+            draining = true;
+        }
+        pop_heap(bucket.begin(), bucket.end(), greater<int>());
+        int vertex = bucket.back();
+        bucket.pop_back();
+        count--;
+        return {current, vertex};
+    }
+};
+
+/**
+ * Class RadixHeap
+ * Monotone queue for non-negative integer keys: a key is kept in the bucket of
+ * the highest bit in which it differs from the last popped key, and a bucket is
+ * spread over the lower ones when the keys equal to the last are exhausted
+ * @tparam T Type of the key
+ */
+template<typename T>
+class RadixHeap{
+    typedef typename make_unsigned<T>::type Key;
+    static const int BUCKETS = numeric_limits<Key>::digits + 1;
+
+    vector< pair<Key, int> > buckets[BUCKETS];  // Bucket 0 holds the keys equal to the last, as a heap
+    Key last = 0;
+    size_t count = 0;
+
+    int bucketOf(Key key) const{
+        return key == last ? 0 : 64 - __builtin_clzll((unsigned long long) (key ^ last));
+    }
+
+public:
+    bool empty() const{
+        return count == 0;
+    }
+
+    void push(T key, int vertex){
+        int bucket = bucketOf(key);
+        buckets[bucket].emplace_back(key, vertex);
+        if (bucket == 0)
+            push_heap(buckets[0].begin(), buckets[0].end(), greater< pair<Key, int> >());
+        count++;
+    }
+
+    pair<T, int> pop(){
+        if (buckets[0].empty()){
+            int i = 1;
+            while (buckets[i].empty())
+                i++;
+            last = min_element(buckets[i].begin(), buckets[i].end())->first;
+            for (auto& item : buckets[i])
+                buckets[bucketOf(item.first)].push_back(item);
+            buckets[i].clear();
+            make_heap(buckets[0].begin(), buckets[0].end(), greater< pair<Key, int> >());
+        }
+        pop_heap(buckets[0].begin(), buckets[0].end(), greater< pair<Key, int> >());
+        pair<Key, int> top = buckets[0].back();
+        buckets[0].pop_back();
+        count--;
+        return {(T) top.first, top.second};
+    }
+};
+
+/**
+ * Struct DenseRows
+ * Copy of the adjacency matrix as rows of 32-bit weights and bandwidths for
+ * the vector kernels of dense dijkstra. Empty cells, and the padding up to a
+ * multiple of 16 columns, have the smallest bandwidth and never pass the filter
+ */
+struct DenseRows{
+    static const int LANES = 16;        // Widest vector, in 32-bit lanes
+
+    int version = -1;                   // Version of the graph the copy was taken from
+    int n = 0;
+    int stride = 0;                     // Columns per row including the padding
+    long long edges = 0;
+    int32_t lightest = 0;               // Range of the weights
+    int32_t heaviest = 0;
+    vector<int32_t> weight;
+    vector<int32_t> bandwidth;
+};
+
+/**
+ * Relaxation of one row: for every column j with bandwidth[j] >= W and
+ * base + weight[j] < distance[j], the distance, parent and bottleneck
+ * bandwidth of j are updated, and so is its key unless j is settled
+ */
+typedef void (*RelaxKernel)(const int32_t* weight, const int32_t* bandwidth, int32_t W, int32_t base, int32_t bottleneck,
+                            int32_t u, int32_t* distance, int32_t* key, int32_t* parent, int32_t* through,
+                            const int32_t* settled, int count);
+
+/**
+ * Position of the least key, the first one among equals, -1 if every key is INT_MAX
+ */
+typedef int (*ArgminKernel)(const int32_t* key, int count);
+
+static void relaxScalar(const int32_t* weight, const int32_t* bandwidth, int32_t W, int32_t base, int32_t bottleneck,
+                        int32_t u, int32_t* distance, int32_t* key, int32_t* parent, int32_t* through,
+                        const int32_t* settled, int count){
+    for (int j = 0; j < count; j++){
+        int32_t candidate = base + weight[j];
+        if (bandwidth[j] < W || candidate >= distance[j]) continue;
+        distance[j] = candidate;
+        parent[j] = u;
+        through[j] = min(bottleneck, bandwidth[j]);
+        if (!settled[j])
+            key[j] = candidate;
+    }
+}
+
+static int argminScalar(const int32_t* key, int count){
+    int best = -1;
+    for (int j = 0; j < count; j++)
+        if (key[j] != INT_MAX && (best == -1 || key[j] < key[best]))
+            best = j;
+    return best;
+}
+
+__attribute__((target("avx2")))
+static void relaxAVX2(const int32_t* weight, const int32_t* bandwidth, int32_t W, int32_t base, int32_t bottleneck,
+                      int32_t u, int32_t* distance, int32_t* key, int32_t* parent, int32_t* through,
+                      const int32_t* settled, int count){
+    const __m256i floor = _mm256_set1_epi32(W - 1), from = _mm256_set1_epi32(base);
+    const __m256i via = _mm256_set1_epi32(u), narrowest = _mm256_set1_epi32(bottleneck);
+    for (int j = 0; j < count; j += 8){
+        __m256i width = _mm256_loadu_si256((const __m256i*) (bandwidth + j));
+        __m256i candidate = _mm256_add_epi32(from, _mm256_loadu_si256((const __m256i*) (weight + j)));
+        __m256i current = _mm256_loadu_si256((const __m256i*) (distance + j));
+        __m256i better = _mm256_and_si256(_mm256_cmpgt_epi32(width, floor), _mm256_cmpgt_epi32(current, candidate));
+        if (_mm256_testz_si256(better, better)) continue;
+
+        _mm256_storeu_si256((__m256i*) (distance + j), _mm256_blendv_epi8(current, candidate, better));
+        __m256i* parents = (__m256i*) (parent + j);
+        _mm256_storeu_si256(parents, _mm256_blendv_epi8(_mm256_loadu_si256(parents), via, better));
+        __m256i* throughs = (__m256i*) (through + j);
+        _mm256_storeu_si256(throughs, _mm256_blendv_epi8(_mm256_loadu_si256(throughs), _mm256_min_epi32(narrowest, width), better));
+        __m256i open = _mm256_andnot_si256(_mm256_loadu_si256((const __m256i*) (settled + j)), better);
+        __m256i* keys = (__m256i*) (key + j);
+        _mm256_storeu_si256(keys, _mm256_blendv_epi8(_mm256_loadu_si256(keys), candidate, open));
+    }
+}
+
+__attribute__((target("avx2")))
+static int argminAVX2(const int32_t* key, int count){
+    __m256i best = _mm256_set1_epi32(INT_MAX);
+    for (int j = 0; j < count; j += 8)
+        best = _mm256_min_epi32(best, _mm256_loadu_si256((const __m256i*) (key + j)));
+    best = _mm256_min_epi32(best, _mm256_permute2x128_si256(best, best, 1));
+    best = _mm256_min_epi32(best, _mm256_shuffle_epi32(best, _MM_SHUFFLE(1, 0, 3, 2)));
+    best = _mm256_min_epi32(best, _mm256_shuffle_epi32(best, _MM_SHUFFLE(2, 3, 0, 1)));
+    int32_t least = _mm256_cvtsi256_si32(best);
+    if (least == INT_MAX) return -1;
+    for (int j = 0; j < count; j += 8){
+        __m256i equal = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*) (key + j)), best);
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(equal));
+        if (mask)
+            return j + __builtin_ctz(mask);
+    }
+    return -1;
+}
+
+__attribute__((target("avx512f")))
+static void relaxAVX512(const int32_t* weight, const int32_t* bandwidth, int32_t W, int32_t base, int32_t bottleneck,
+                        int32_t u, int32_t* distance, int32_t* key, int32_t* parent, int32_t* through,
+                        const int32_t* settled, int count){
+    const __m512i floor = _mm512_set1_epi32(W - 1), from = _mm512_set1_epi32(base);
+    const __m512i via = _mm512_set1_epi32(u), narrowest = _mm512_set1_epi32(bottleneck);
+    for (int j = 0; j < count; j += 16){
+        __m512i width = _mm512_loadu_si512(bandwidth + j);
+        __m512i candidate = _mm512_add_epi32(from, _mm512_loadu_si512(weight + j));
+        __mmask16 better = _mm512_cmpgt_epi32_mask(width, floor) &
+                           _mm512_cmpgt_epi32_mask(_mm512_loadu_si512(distance + j), candidate);
+        if (!better) continue;
+
+        _mm512_mask_storeu_epi32(distance + j, better, candidate);
+        _mm512_mask_storeu_epi32(parent + j, better, via);
+        _mm512_mask_storeu_epi32(through + j, better, _mm512_maskz_min_epi32(0xFFFF, narrowest, width));
+        __mmask16 open = better & ~_mm512_test_epi32_mask(_mm512_loadu_si512(settled + j), _mm512_set1_epi32(-1));
+        _mm512_mask_storeu_epi32(key + j, open, candidate);
+    }
+}
+
+__attribute__((target("avx512f")))
+static int argminAVX512(const int32_t* key, int count){
+    __m512i best = _mm512_set1_epi32(INT_MAX);
+    for (int j = 0; j < count; j += 16)
+        best = _mm512_maskz_min_epi32(0xFFFF, best, _mm512_loadu_si512(key + j));
+    int32_t lanes[16];
+    _mm512_storeu_si512(lanes, best);
+    int32_t least = *min_element(lanes, lanes + 16);
+    if (least == INT_MAX) return -1;
+    const __m512i target = _mm512_set1_epi32(least);
+    for (int j = 0; j < count; j += 16){
+        __mmask16 equal = _mm512_cmpeq_epi32_mask(_mm512_loadu_si512(key + j), target);
+        if (equal)
+            return j + __builtin_ctz(equal);
+    }
+    return -1;
+}
+
+/**
+ * Struct VectorKernels
+ * Kernels of dense dijkstra for one instruction set
+ */
+struct VectorKernels{
+    const char* name;
+    RelaxKernel relax;
+    ArgminKernel argmin;
+
+    /**
+     * Method that tells whether the processor runs the kernels
+     * @return Whether the instruction set is available
+     */
+    bool supported() const{
+        if (relax == relaxAVX512) return __builtin_cpu_supports("avx512f");
+        if (relax == relaxAVX2) return __builtin_cpu_supports("avx2");
+        return true;
+    }
+};
+
+static const VectorKernels KERNELS[] = {
+    {"scalar", relaxScalar, argminScalar},
+    {"avx2", relaxAVX2, argminAVX2},
+    {"avx512", relaxAVX512, argminAVX512}
+};
+static int kernelChoice = -1;           // Index in KERNELS chosen by SIMD, -1 for the widest supported
+
+/**
+ * Method that returns the kernels dense dijkstra runs with
+ * @return The chosen kernels, or the widest ones the processor supports
+ */
+static const VectorKernels& vectorKernels(){
+    if (kernelChoice != -1 && KERNELS[kernelChoice].supported())
+        return KERNELS[kernelChoice];
+    for (int i = 2; i > 0; i--)
+        if (KERNELS[i].supported())
+            return KERNELS[i];
+    return KERNELS[0];
+}
 
 /**
  * An abstract class of Graph ADT
@@ -140,6 +734,32 @@ class AdjacencyMatrixGraph: public Graph<V,E>{
 public:
     vector<Vertex<V>*> vertices;        // vector of vertices
     vector< vector<Edge<E>*> > edges;   // vector of vectors of edges
+    int version = 0;                    // Number of mutations, invalidates cached structures
+    bool denseEnabled = true;           // Whether dijkstra may use the dense copy and vector kernels
+
+private:
+    vector<int> topology;               // Cached topological order, empty if cyclic
+    int topologyVersion = -1;           // Version the cached order was computed for
+    DenseRows dense;                    // Copy of the matrix for dense dijkstra, patched by edge changes
+
+    /**
+     * Method that carries a change of one cell over to a current dense copy
+     * @param from Index of the source vertex
+     * @param to Index of the target vertex
+     * @param edge New content of the cell
+     */
+    void patchDense(int from, int to, Edge<E>* edge){
+        if (dense.version != version - 1) return;
+        size_t cell = (size_t) from * dense.stride + to;
+        dense.edges += (edge->isEmpty ? 0 : 1) - (dense.bandwidth[cell] == INT_MIN ? 0 : 1);
+        dense.weight[cell] = edge->isEmpty ? 0 : edge->weight;
+        dense.bandwidth[cell] = edge->isEmpty ? INT_MIN : edge->bandwidth;
+        if (!edge->isEmpty){
+            dense.lightest = min<int32_t>(dense.lightest, edge->weight);
+            dense.heaviest = max<int32_t>(dense.heaviest, edge->weight);
+        }
+        dense.version = version;
+    }
 
 public:
     /**
@@ -159,6 +779,37 @@ public:
         return -1;
     }
 
+    /**
+     * Method that returns a view over the edges going from a vertex
+     * @param index Index of the vertex
+     * @return Pairs of the target index and the edge
+     */
+    NeighbourRange<E> outNeighbours(int index){
+        return NeighbourRange<E>(edges, index, false);
+    }
+
+    /**
+     * Method that returns a view over the edges going to a vertex
+     * @param index Index of the vertex
+     * @return Pairs of the source index and the edge
+     */
+    NeighbourRange<E> inNeighbours(int index){
+        return NeighbourRange<E>(edges, index, true);
+    }
+
+    /**
+     * Method that records the position of an edge in the matrix
+     * @param edge Edge
+     * @param from Index of the source vertex
+     * @param to Index of the target vertex
+     * @return The same edge
+     */
+    static Edge<E>* place(Edge<E>* edge, int from, int to){
+        edge->from = from;
+        edge->to = to;
+        return edge;
+    }
+
     /**
      * Overriding of the Method that adds a vertex with value to the graph
      * @param value Title of the vertex
@@ -170,18 +821,20 @@ public:
             return vertices[index];
         }
 
+        version++;
         vertices.resize(vertices.size() + 1);
         auto newVertex = new Vertex<V>(value);
         vertices[vertices.size() - 1] = newVertex;
 
+        int last = vertices.size() - 1;
         vector<Edge<E>*> v;
         for (int i = 0; i < vertices.size(); i++){
-            v.push_back(new Edge<E>);
+            v.push_back(place(new Edge<E>(), last, i));
         }
         edges.push_back(v);
 
         for (int i = 0; i < vertices.size() - 1; i++)
-            edges[i].push_back(new Edge<E>);
+            edges[i].push_back(place(new Edge<E>(), i, last));
 
         return newVertex;
     }
@@ -192,6 +845,7 @@ public:
      */
     void removeVertex(Vertex<V> *v) override{
         int index = getIndex(v);
+        version++;
         vertices.erase(vertices.begin() + index);
 
         edges.erase(edges.begin() + index);
@@ -200,6 +854,10 @@ public:
             edges[i].erase(edges[i].begin() + index);
         }
 
+        for (int i = 0; i < vertices.size(); i++)
+            for (int j = (i < index ? index : 0); j < vertices.size(); j++)
+                place(edges[i][j], i, j);
+
     }
 
     /**
@@ -224,7 +882,10 @@ public:
                 break;
         }
 
-        edges[fromVertexID][toVertexID] = new Edge<E>(weight, bandwidth);
+        version++;
+        edges[fromVertexID][toVertexID] = place(new Edge<E>(weight, bandwidth), fromVertexID, toVertexID);
+        if constexpr (is_same<E, int32_t>::value)
+            patchDense(fromVertexID, toVertexID, edges[fromVertexID][toVertexID]);
 
         return edges[fromVertexID][toVertexID];
     }
@@ -234,8 +895,11 @@ public:
      * @param e Reference to an edge object
      */
     void removeEdge(Edge<E>* e) override{
+        version++;
         e->isEmpty = true;
         e->weight = 0;
+        if constexpr (is_same<E, int32_t>::value)
+            patchDense(e->from, e->to, e);
     }
 
     /**
@@ -246,10 +910,8 @@ public:
      */
     vector<Edge<E>*> edgesFrom(Vertex<V>* v) override{
         vector<Edge<E>*> result;
-        int index = getIndex(v);
-        for (auto edge : edges[index])
-            if (!edge->isEmpty)
-                result.push_back(edge);
+        for (auto neighbour : outNeighbours(getIndex(v)))
+            result.push_back(neighbour.second);
         return result;
     }
 
@@ -261,10 +923,8 @@ public:
      */
     vector<Edge<E>*> edgesTo(Vertex<V>* v) override{
         vector<Edge<E>*> result;
-        int index = getIndex(v);
-        for (auto edge : edges)
-            if (!edge[index]->isEmpty)
-                result.push_back(edge[index]);
+        for (auto neighbour : inNeighbours(getIndex(v)))
+            result.push_back(neighbour.second);
         return result;
     }
 
@@ -314,113 +974,3064 @@ public:
      * Method that transpose the graph
      */
     void transpose(){
+        version++;
         for (int i = 0; i < vertices.size() - 1; i++)
             for (int j = i + 1; j < vertices.size(); j++){
                 Edge<E>* temp;
                 temp = edges[i][j];
-                edges[i][j] = edges[j][i];
-                edges[j][i] = temp;
+                edges[i][j] = place(edges[j][i], i, j);
+                edges[j][i] = place(temp, j, i);
             }
     }
 
     /**
-     * Dijkstra algorithm
-     * @param from Index of vertex
-     * @param to Index of vertex
-     * @param W Bandwidth
+     * Method that computes an order of the vertices placing neighbours close together
+     * @param method BFS, RCM (reverse Cuthill-McKee), DEGREE or GORDER
+     * @return Current indices of the vertices in their new order
      */
-    void dijkstra(int from, int to, int W) {
-
-        int MAX = INT_MAX-1000;
-        vector <bool> visited = vector<bool>(vertices.size(), false);
-        vector <E> weightPath = vector<E>(vertices.size(), MAX);
-        vector <E> bandwidthPath = vector<E>(vertices.size(), MAX);
-        vector <vector <int>> vertexPath(vertices.size(), vector <int>(0));
-
-        for (int i = 0; i < vertexPath.size(); i++){
-            if (i != from)
-                vertexPath[i].push_back(from);
+    vector<int> localityOrder(const string& method){
+        int n = vertices.size();
+        vector< vector<int> > out(n), in(n), around(n);
+        for (int i = 0; i < n; i++)
+            for (auto neighbour : outNeighbours(i)){
+                out[i].push_back(neighbour.first);
+                in[neighbour.first].push_back(i);
+            }
+        for (int i = 0; i < n; i++){
+            merge(out[i].begin(), out[i].end(), in[i].begin(), in[i].end(), back_inserter(around[i]));
+            around[i].erase(unique(around[i].begin(), around[i].end()), around[i].end());
         }
+        auto degree = [&](int v){
+            return around[v].size();
+        };
 
-        weightPath[from] = 0;
-
-        priority_queue<E> pqueue;
-        pqueue.push(from);
-
-        while (!pqueue.empty()) {
-            E currentVertex = pqueue.top();
-            pqueue.pop();
-            visited[currentVertex] = true;
-
-            for (int i = 0; i < vertices.size(); i++){
-                if (edges[currentVertex][i]->isEmpty == true) continue;
-                //if (visited[i]) continue;
-                if (edges[currentVertex][i]->bandwidth < W) continue;
-
-                E currentPath = weightPath[currentVertex];
-                E currentBandwidth = bandwidthPath[currentVertex];
-
-                E edgeWeight = edges[currentVertex][i]->weight;
-                E edgeBandwidth = edges[currentVertex][i]->bandwidth;
+        vector<int> order;
+        vector<bool> placed(n, false);
+        if (method == "DEGREE"){
+            for (int v = 0; v < n; v++)
+                order.push_back(v);
+            stable_sort(order.begin(), order.end(), [&](int a, int b){ return degree(a) > degree(b); });
+        }
+        else if (method == "GORDER"){
+            // Greedy Gorder: the next vertex shares the most edges and in-neighbours with the last WINDOW placed
+            const int WINDOW = 5;
+            vector<long long> score(n, 0);
+            auto adjust = [&](int v, int delta){
+                for (int u : out[v])
+                    score[u] += delta;
+                for (int u : in[v])
+                    score[u] += delta;
+                for (int w : in[v])
+                    for (int u : out[w])
+                        score[u] += delta;
+            };
+            for (int k = 0; k < n; k++){
+                if (k > WINDOW)
+                    adjust(order[k - WINDOW - 1], -1);
+                int next = -1;
+                for (int v = 0; v < n; v++)
+                    if (!placed[v] && (next == -1 || (k == 0 ? in[v].size() > in[next].size() : score[v] > score[next])))
+                        next = v;
+                placed[next] = true;
+                order.push_back(next);
+                adjust(next, 1);
+            }
+        }
+        else{
+            // Breadth-first numbering of every component; RCM starts from a vertex of least degree,
+            // visits neighbours by increasing degree and reverses the result
+            bool cuthillMcKee = method == "RCM";
+            vector<int> roots;
+            for (int v = 0; v < n; v++)
+                roots.push_back(v);
+            if (cuthillMcKee)
+                stable_sort(roots.begin(), roots.end(), [&](int a, int b){ return degree(a) < degree(b); });
+            for (int root : roots){
+                if (placed[root]) continue;
+                placed[root] = true;
+                order.push_back(root);
+                for (size_t head = order.size() - 1; head < order.size(); head++){
+                    vector<int> next;
+                    for (int u : around[order[head]])
+                        if (!placed[u]){
+                            placed[u] = true;
+                            next.push_back(u);
+                        }
+                    if (cuthillMcKee)
+                        stable_sort(next.begin(), next.end(), [&](int a, int b){ return degree(a) < degree(b); });
+                    order.insert(order.end(), next.begin(), next.end());
+                }
+            }
+            if (cuthillMcKee)
+                reverse(order.begin(), order.end());
+        }
+        return order;
+    }
 
-                if (weightPath[currentVertex] + edgeWeight < weightPath[i]){
-                    if (vertexPath[i].back() != currentVertex){
-                        vertexPath[i] = vertexPath[currentVertex];
-                        vertexPath[i].push_back(currentVertex);
-                    }
+    /**
+     * Method that renumbers the vertices. Titles move with their vertices,
+     * and the edges are copied into objects allocated in the new row order
+     * so that scanning a row walks memory sequentially
+     * @param order Current indices of the vertices in their new order
+     */
+    void reorder(const vector<int>& order){
+        int n = vertices.size();
+        version++;
+        vector<Vertex<V>*> moved(n);
+        vector< vector<Edge<E>*> > rows(n, vector<Edge<E>*>(n));
+        for (int i = 0; i < n; i++){
+            moved[i] = vertices[order[i]];
+            for (int j = 0; j < n; j++){
+                Edge<E>* old = edges[order[i]][order[j]];
+                rows[i][j] = place(old->isEmpty ? new Edge<E>() : new Edge<E>(old->weight, old->bandwidth), i, j);
+            }
+        }
+        for (auto& row : edges)
+            for (Edge<E>* edge : row)
+                delete edge;
+        vertices.swap(moved);
+        edges.swap(rows);
+    }
 
+    enum QueueKind {AUTOMATIC, BINARY, DARY, BUCKETS, RADIX};
+    static const int BUCKET_LIMIT = 1 << 16;    // Widest edge served by Dial's buckets
 
-                    if (edgeBandwidth < bandwidthPath[currentVertex])
-                        bandwidthPath[i] = edgeBandwidth;
-                    else
-                        bandwidthPath[i] = bandwidthPath[currentVertex];
+    /**
+     * Method that settles the vertices in order of distance and then of index
+     * @param n Number of vertices
+     * @param from Index of vertex
+     * @param W Bandwidth
+     * @param queue Empty priority queue
+     * @param rows Function giving the pairs of target index and edge going from a vertex
+     * @param distance Length of the shortest path to every vertex, infinity where unreachable
+     * @param parent Previous vertex on the shortest path, -1 for the start and unreached vertices
+     * @param profile Counters of the work done
+     */
+    template<typename Queue, typename Rows, typename Profile>
+    static void settle(int n, int from, E W, Queue& queue, Rows rows, vector<E>& distance, vector<int>& parent,
+                       Profile& profile){
+        const size_t ITEM = sizeof(pair<E, int>);
+        vector<bool> visited(n, false);
+        distance.assign(n, WeightTraits<E>::infinity());
+        parent.assign(n, -1);
+        profile.allocate(n * (sizeof(E) + sizeof(int)) + (n + 7) / 8);
+        distance[from] = 0;
+        queue.push(0, from);
+        profile.push(ITEM);
 
-                    weightPath[i] = edgeWeight + weightPath[currentVertex];
+        while (!queue.empty()){
+            auto item = queue.pop();
+            profile.pop(ITEM);
+            int u = item.second;
+            if (visited[u] || item.first != distance[u]) continue;
+            visited[u] = true;
+            profile.settle();
 
+            for (auto neighbour : rows(u)){
+                int v = neighbour.first;
+                Edge<E>* edge = neighbour.second;
+                profile.scan();
+                if (edge->bandwidth < W){
+                    profile.skip();
+                    continue;
                 }
-
-            }
-            int min = INT_MAX;
-            int minIndex = 0;
-            for (int i = 0; i < vertices.size(); i++) {
-                if (weightPath[i] < min && !visited[i]) {
-                    min = weightPath[i];
-                    minIndex = i;
+                if (!(distance[u] + edge->weight < distance[v])) continue;
+                distance[v] = distance[u] + edge->weight;
+                parent[v] = u;
+                if (!visited[v]){
+                    queue.push(distance[v], v);
+                    profile.push(ITEM);
                 }
             }
-            if (!visited[minIndex])
-                pqueue.push(minIndex);
-
-
         }
+    }
 
+    /**
+     * Method that finds the shortest paths from a vertex. Integer weights are
+     * queued in Dial's buckets while the widest edge is narrow and in a radix
+     * heap otherwise, other weights and negative lengths in a 4-ary heap
+     * @param n Number of vertices
+     * @param from Index of vertex
+     * @param W Bandwidth
+     * @param rows Function giving the pairs of target index and edge going from a vertex
+     * @param distance Length of the shortest path to every vertex, infinity where unreachable
+     * @param parent Previous vertex on the shortest path, -1 for the start and unreached vertices
+     * @param kind Priority queue, AUTOMATIC to choose it; an unsuitable one falls back to DARY
+     * @param profile Counters of the work done
+     * @return Priority queue used
+     */
+    template<typename Rows, typename Profile = NoProfile>
+    static QueueKind distances(int n, int from, E W, Rows rows, vector<E>& distance, vector<int>& parent,
+                               QueueKind kind = AUTOMATIC, Profile& profile = noProfile){
+        profile.phase("prescan");
+        E widest = 0;
+        bool negative = false;
+        for (int u = 0; u < n; u++)
+            for (auto neighbour : rows(u))
+                if (neighbour.second->bandwidth >= W){
+                    negative |= neighbour.second->weight < 0;
+                    widest = max(widest, neighbour.second->weight);
+                }
 
-        for(int i = 0; i < vertexPath.size(); i++)
-            if (!vertexPath[i].empty() ){
-                if (vertexPath[i].back() != i)
-                    vertexPath[i].push_back(i);
+        profile.phase("settle");
+        if constexpr (WeightTraits<E>::integral){
+            if (kind == AUTOMATIC)
+                kind = negative ? DARY : widest <= BUCKET_LIMIT ? BUCKETS : RADIX;
+            if (kind == BUCKETS && !negative && widest <= BUCKET_LIMIT){
+                BucketQueue<E> queue(widest);
+                settle(n, from, W, queue, rows, distance, parent, profile);
+                return BUCKETS;
             }
-            else{
-                vertexPath[i].push_back(i);
+            if (kind == RADIX && !negative){
+                RadixHeap<E> queue;
+                settle(n, from, W, queue, rows, distance, parent, profile);
+                return RADIX;
             }
-
-
-        if ( (vertexPath[to].size() == 1 && to == from) || weightPath[to] == MAX){
-            cout << "IMPOSSIBLE" << endl;
-            return;
         }
-
-        cout << vertexPath[to].size() << " " << weightPath[to] << " " << bandwidthPath[to] << endl;
-        for (auto vertex: vertexPath[to]){
-            cout << vertex + 1 << " ";
+        if (kind == BINARY){
+            DaryHeap<E, 2> queue;
+            settle(n, from, W, queue, rows, distance, parent, profile);
+            return BINARY;
         }
+        DaryHeap<E, 4> queue;
+        settle(n, from, W, queue, rows, distance, parent, profile);
+        return DARY;
+    }
 
-        return;
+    /**
+     * Method that returns the dense copy of the matrix, taken again after
+     * changes other than adding and removing edges
+     * @return Rows of weights and bandwidths
+     */
+    const DenseRows& denseRows(){
+        if (dense.version == version)
+            return dense;
+        int n = vertices.size();
+        dense.version = version;
+        dense.n = n;
+        dense.stride = (n + DenseRows::LANES - 1) / DenseRows::LANES * DenseRows::LANES;
+        dense.edges = 0;
+        dense.lightest = dense.heaviest = 0;
+        dense.weight.assign((size_t) n * dense.stride, 0);
+        dense.bandwidth.assign((size_t) n * dense.stride, INT_MIN);
+        for (int u = 0; u < n; u++)
+            for (auto neighbour : outNeighbours(u)){
+                size_t cell = (size_t) u * dense.stride + neighbour.first;
+                dense.weight[cell] = neighbour.second->weight;
+                dense.bandwidth[cell] = neighbour.second->bandwidth;
+                dense.lightest = min<int32_t>(dense.lightest, neighbour.second->weight);
+                dense.heaviest = max<int32_t>(dense.heaviest, neighbour.second->weight);
+                dense.edges++;
+            }
+        return dense;
     }
-};
 
-/**
- * Method that solves current problem
+    /**
+     * Method that finds the shortest paths with dijkstra over the dense copy,
+     * relaxing a whole row and picking the next vertex with vector kernels.
+     * Vertices are settled in the same order as with a priority queue
+     * @param from Index of vertex
+     * @param W Bandwidth
+     * @param distance Length of the shortest path to every vertex, infinity where unreachable
+     * @param parent Previous vertex on the shortest path, -1 for the start and unreached vertices
+     * @param through Narrowest bandwidth on the shortest path to every vertex
+     * @param kernels Vector kernels
+     * @param profile Counters of the work done
+     * @return False if the weights are not 32-bit integers or a sum could leave their range
+     */
+    template<typename Profile = NoProfile>
+    bool denseDistances(int from, E W, vector<E>& distance, vector<int>& parent, vector<E>& through,
+                        const VectorKernels& kernels, Profile& profile = noProfile){
+        if constexpr (!is_same<E, int32_t>::value)
+            return false;
+        else{
+            if (!denseEnabled) return false;
+            profile.phase("copy");
+            int n = vertices.size();
+            const DenseRows& rows = denseRows();
+            if (rows.lightest < 0 || (long long) rows.heaviest * max(n - 1, 1) >= INT_MAX)
+                return false;
+
+            profile.phase("dense");
+            int stride = rows.stride;
+            vector<int32_t> key(stride, INT_MAX), settled(stride, 0), length(stride, INT_MAX), previous(stride, -1),
+                            narrowest(stride, INT_MAX);
+            profile.allocate(5 * stride * sizeof(int32_t));
+            length[from] = key[from] = 0;
+            int32_t floor = max<int32_t>(W, INT_MIN + 1);
+            for (int u; (u = kernels.argmin(key.data(), stride)) != -1;){
+                key[u] = INT_MAX;
+                settled[u] = -1;
+                profile.settle();
+                kernels.relax(&rows.weight[(size_t) u * stride], &rows.bandwidth[(size_t) u * stride], floor, length[u],
+                              narrowest[u], u, length.data(), key.data(), previous.data(), narrowest.data(),
+                              settled.data(), stride);
+            }
+            distance.assign(length.begin(), length.begin() + n);
+            parent.assign(previous.begin(), previous.begin() + n);
+            through.assign(narrowest.begin(), narrowest.begin() + n);
+            return true;
+        }
+    }
+
+    /**
+     * Dijkstra algorithm
+     * @param from Index of vertex
+     * @param to Index of vertex
+     * @param W Bandwidth
+     * @param profile Counters of the work done
+     */
+    template<typename Profile = NoProfile>
+    void dijkstra(int from, int to, E W, Profile& profile = noProfile) {
+        vector<E> distance, through;
+        vector<int> parent;
+        if (!denseDistances(from, W, distance, parent, through, vectorKernels(), profile))
+            distances(vertices.size(), from, W, [this](int u){ return outNeighbours(u); }, distance, parent, AUTOMATIC, profile);
+        profile.phase("print");
+
+        if (from == to || distance[to] == WeightTraits<E>::infinity()){
+            cout << "IMPOSSIBLE" << endl;
+            return;
+        }
+        printPath(parent, to, distance[to]);
+    }
+
+    /**
+     * Method that returns a topological order of the vertices,
+     * cached until the next mutation of the graph
+     * @return Indices of the vertices, empty if the graph has a cycle
+     */
+    const vector<int>& topologicalOrder(){
+        if (topologyVersion == version)
+            return topology;
+
+        int n = vertices.size();
+        vector<int> inDegree(n, 0);
+        for (int u = 0; u < n; u++)
+            for (auto neighbour : outNeighbours(u))
+                inDegree[neighbour.first]++;
+
+        topology.clear();
+        for (int v = 0; v < n; v++)
+            if (inDegree[v] == 0)
+                topology.push_back(v);
+        for (int i = 0; i < topology.size(); i++)
+            for (auto neighbour : outNeighbours(topology[i]))
+                if (--inDegree[neighbour.first] == 0)
+                    topology.push_back(neighbour.first);
+
+        if (topology.size() != n)
+            topology.clear();
+        topologyVersion = version;
+        return topology;
+    }
+
+    /**
+     * Method that computes paths by relaxing edges in topological order,
+     * which also handles negative weights
+     * @param from Index of vertex, -1 to start from every vertex
+     * @param W Bandwidth
+     * @param longest Whether to maximise the length instead of minimising it
+     * @param length Length of the best path to every vertex
+     * @param parent Previous vertex on the best path, -1 for starts and unreached vertices
+     * @param reached Whether a vertex is reachable
+     * @param profile Counters of the work done
+     * @return False if the graph has a cycle
+     */
+    template<typename Profile = NoProfile>
+    bool dagPaths(int from, E W, bool longest, vector<E>& length, vector<int>& parent, vector<bool>& reached,
+                  Profile& profile = noProfile){
+        profile.phase("order");
+        const vector<int>& order = topologicalOrder();
+        if (order.size() != vertices.size())
+            return false;
+
+        profile.phase("relax");
+        length.assign(vertices.size(), 0);
+        parent.assign(vertices.size(), -1);
+        reached.assign(vertices.size(), from == -1);
+        profile.allocate(vertices.size() * (sizeof(E) + sizeof(int)) + (vertices.size() + 7) / 8);
+        if (from != -1)
+            reached[from] = true;
+
+        for (int u : order){
+            if (!reached[u]) continue;
+            profile.settle();
+            for (auto neighbour : outNeighbours(u)){
+                int v = neighbour.first;
+                Edge<E>* edge = neighbour.second;
+                profile.scan();
+                if (edge->bandwidth < W){
+                    profile.skip();
+                    continue;
+                }
+
+                E candidate = length[u] + edge->weight;
+                bool better = longest ? candidate > length[v] : candidate < length[v];
+                if (reached[v] && !better) continue;
+                reached[v] = true;
+                length[v] = candidate;
+                parent[v] = u;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Method that prints the shortest path, relaxing edges in topological
+     * order on acyclic graphs and falling back to dijkstra otherwise
+     * @param from Index of vertex
+     * @param to Index of vertex
+     * @param W Bandwidth
+     * @param profile Counters of the work done
+     */
+    template<typename Profile = NoProfile>
+    void shortestPath(int from, int to, E W, Profile& profile = noProfile){
+        vector<E> length;
+        vector<int> parent;
+        vector<bool> reached;
+        if (!dagPaths(from, W, false, length, parent, reached, profile)){
+            dijkstra(from, to, W, profile);
+            return;
+        }
+        profile.phase("print");
+        if (from == to || !reached[to]){
+            cout << "IMPOSSIBLE" << endl;
+            return;
+        }
+        printPath(parent, to, length[to]);
+    }
+
+    /**
+     * Method that prints the longest path between two vertices of an acyclic graph
+     * @param from Index of vertex
+     * @param to Index of vertex
+     * @param W Bandwidth
+     * @param profile Counters of the work done
+     */
+    template<typename Profile = NoProfile>
+    void longestPath(int from, int to, E W, Profile& profile = noProfile){
+        vector<E> length;
+        vector<int> parent;
+        vector<bool> reached;
+        bool acyclic = dagPaths(from, W, true, length, parent, reached, profile);
+        profile.phase("print");
+        if (!acyclic || from == to || !reached[to]){
+            cout << "IMPOSSIBLE" << endl;
+            return;
+        }
+        printPath(parent, to, length[to]);
+    }
+
+    /**
+     * Method that prints the longest path anywhere in an acyclic graph
+     * @param W Bandwidth
+     * @param profile Counters of the work done
+     */
+    template<typename Profile = NoProfile>
+    void criticalPath(E W, Profile& profile = noProfile){
+        vector<E> length;
+        vector<int> parent;
+        vector<bool> reached;
+        int end = -1;
+        bool acyclic = dagPaths(-1, W, true, length, parent, reached, profile);
+        profile.phase("print");
+        if (acyclic)
+            for (int v = 0; v < vertices.size(); v++)
+                if (parent[v] != -1 && (end == -1 || length[v] > length[end]))
+                    end = v;
+        if (end == -1){
+            cout << "IMPOSSIBLE" << endl;
+            return;
+        }
+        printPath(parent, end, length[end]);
+    }
+
+    /**
+     * Method that prints a path in the output format of dijkstra
+     * @param parent Previous vertex on the path to every vertex
+     * @param to Index of the last vertex
+     * @param length Total length of the path
+     */
+    void printPath(const vector<int>& parent, int to, E length){
+        vector<int> path;
+        for (int v = to; v != -1; v = parent[v])
+            path.push_back(v);
+        reverse(path.begin(), path.end());
+        printPath(path, length);
+    }
+
+    /**
+     * Method that prints a path given by its vertices in the output format of dijkstra
+     * @param path Indices of the vertices from the first to the last
+     * @param length Total length of the path
+     */
+    void printPath(const vector<int>& path, E length){
+        E bandwidth = numeric_limits<E>::max();
+        for (int i = 0; i + 1 < path.size(); i++)
+            bandwidth = min(bandwidth, edges[path[i]][path[i + 1]]->bandwidth);
+
+        cout << path.size() << " " << length << " " << bandwidth << endl;
+        for (int v : path){
+            cout << vertices[v]->title + 1 << " ";
+        }
+        cout << endl;
+    }
+};
+
+/**
+ * Class ContractionHierarchy
+ * Preprocessed index over the edges whose bandwidth is at least the tier,
+ * answering exact point-to-point queries with a bidirectional upward search
+ * @tparam E Type of the weight
+ */
+template<typename E>
+class ContractionHierarchy{
+public:
+    /**
+     * Arc of the hierarchy, either an original edge or a shortcut
+     */
+    struct Arc{
+        int to;         // Vertex on the other side of the arc
+        E weight;       // Length of the arc
+        E bandwidth;    // Bottleneck bandwidth of the arc
+        int middle;     // Vertex bypassed by a shortcut, -1 for an original edge
+    };
+
+    E tier = 0;                             // Minimum bandwidth of indexed edges
+    unsigned long long signature = 0;       // Fingerprint of the indexed graph
+    vector<int> rank;                       // Contraction order of the vertices
+    vector< vector<Arc> > up;               // Arcs to higher ranked vertices
+    vector< vector<Arc> > down;             // Arcs from higher ranked vertices, stored reversed
+
+private:
+    static const int WITNESS_LIMIT = 500;   // Settled vertices per witness search
+
+    vector< vector<Arc> > out;              // Remaining out-arcs while contracting
+    vector< vector<Arc> > in;               // Remaining in-arcs while contracting
+    vector<E> distance;                     // Scratch distances of the searches
+    vector<E> backDistance;                 // Scratch distances of the backward search
+    vector< pair<int, int> > parent;        // Forward search tree as (vertex, arc index)
+    vector< pair<int, int> > backParent;    // Backward search tree as (vertex, arc index)
+
+    typedef pair<E, int> Item;
+    typedef priority_queue<Item, vector<Item>, greater<Item> > Queue;
+
+    static E infinity(){
+        return numeric_limits<E>::max();
+    }
+
+public:
+    /**
+     * Method that computes a fingerprint of the edges of the graph
+     * @param graph Graph
+     * @return Fingerprint used to detect a stale index
+     */
+    template<typename V>
+    static unsigned long long fingerprint(AdjacencyMatrixGraph<V, E>& graph){
+        unsigned long long hash = 1469598103934665603ULL;
+        auto mix = [&hash](unsigned long long value){
+            for (int k = 0; k < 8; k++){
+                hash ^= (value >> (8 * k)) & 0xff;
+                hash *= 1099511628211ULL;
+            }
+        };
+        mix(graph.vertices.size());
+        for (int i = 0; i < graph.vertices.size(); i++)
+            for (int j = 0; j < graph.vertices.size(); j++)
+                if (!graph.edges[i][j]->isEmpty){
+                    mix(i);
+                    mix(j);
+                    mix((unsigned long long) graph.edges[i][j]->weight);
+                    mix((unsigned long long) graph.edges[i][j]->bandwidth);
+                }
+        return hash;
+    }
+
+    /**
+     * Method that contracts the graph into a hierarchy
+     * @param graph Graph
+     * @param W Bandwidth tier
+     */
+    template<typename V>
+    void build(AdjacencyMatrixGraph<V, E>& graph, E W){
+        int n = graph.vertices.size();
+        tier = W;
+        signature = fingerprint(graph);
+        rank.assign(n, -1);
+        up.assign(n, vector<Arc>());
+        down.assign(n, vector<Arc>());
+        out.assign(n, vector<Arc>());
+        in.assign(n, vector<Arc>());
+        distance.assign(n, infinity());
+
+        for (int i = 0; i < n; i++)
+            for (auto neighbour : graph.outNeighbours(i)){
+                int j = neighbour.first;
+                Edge<E>* edge = neighbour.second;
+                if (i == j || edge->bandwidth < W) continue;
+                out[i].push_back({j, edge->weight, edge->bandwidth, -1});
+                in[j].push_back({i, edge->weight, edge->bandwidth, -1});
+            }
+
+        // Node ordering by edge difference plus the number of contracted neighbours,
+        // priorities are refreshed lazily when a vertex reaches the top of the queue
+        vector<int> contractedNeighbours(n, 0);
+        vector< pair<int, Arc> > shortcuts;
+        priority_queue< pair<int, int>, vector< pair<int, int> >, greater< pair<int, int> > > order;
+        for (int v = 0; v < n; v++){
+            findShortcuts(v, shortcuts);
+            order.push({(int) shortcuts.size() - (int) (in[v].size() + out[v].size()), v});
+        }
+
+        int next = 0;
+        while (!order.empty()){
+            int v = order.top().second;
+            order.pop();
+
+            findShortcuts(v, shortcuts);
+            int priority = (int) shortcuts.size() - (int) (in[v].size() + out[v].size()) + contractedNeighbours[v];
+            if (!order.empty() && priority > order.top().first){
+                order.push({priority, v});
+                continue;
+            }
+
+            rank[v] = next++;
+            up[v] = out[v];
+            down[v] = in[v];
+            for (Arc& arc : in[v]){
+                removeArc(out[arc.to], v);
+                contractedNeighbours[arc.to]++;
+            }
+            for (Arc& arc : out[v]){
+                removeArc(in[arc.to], v);
+                contractedNeighbours[arc.to]++;
+            }
+            for (auto& shortcut : shortcuts)
+                addArc(shortcut.first, shortcut.second);
+            out[v].clear();
+            in[v].clear();
+        }
+
+        out.clear();
+        in.clear();
+    }
+
+    /**
+     * Method that answers a query and prints it in the format of dijkstra
+     * @param graph Graph the hierarchy was built from, naming the vertices
+     * @param from Index of vertex
+     * @param to Index of vertex
+     */
+    template<typename V>
+    void route(AdjacencyMatrixGraph<V, E>& graph, int from, int to){
+        vector<int> path;
+        E length, bandwidth;
+        if (from == to || !query(from, to, path, length, bandwidth)){
+            cout << "IMPOSSIBLE" << endl;
+            return;
+        }
+
+        cout << path.size() << " " << length << " " << bandwidth << endl;
+        for (auto vertex: path){
+            cout << graph.vertices[vertex]->title + 1 << " ";
+        }
+        cout << endl;
+    }
+
+    /**
+     * Method that runs the bidirectional upward search
+     * @param from Index of vertex
+     * @param to Index of vertex
+     * @param path Unpacked vertices of the shortest path
+     * @param length Total length of the path
+     * @param bandwidth Bandwidth of the path
+     * @return Whether the target is reachable
+     */
+    bool query(int from, int to, vector<int>& path, E& length, E& bandwidth){
+        int n = rank.size();
+        distance.assign(n, infinity());
+        backDistance.assign(n, infinity());
+        parent.assign(n, {-1, -1});
+        backParent.assign(n, {-1, -1});
+
+        Queue forward, backward;
+        distance[from] = 0;
+        backDistance[to] = 0;
+        forward.push({0, from});
+        backward.push({0, to});
+
+        E best = infinity();
+        int meeting = -1;
+        while (!forward.empty() || !backward.empty()){
+            bool isForward = backward.empty() || (!forward.empty() && forward.top().first <= backward.top().first);
+            Queue& queue = isForward ? forward : backward;
+            if (queue.top().first >= best){
+                queue = Queue();
+                continue;
+            }
+
+            Item top = queue.top();
+            queue.pop();
+            int u = top.second;
+            vector<E>& settled = isForward ? distance : backDistance;
+            vector<E>& opposite = isForward ? backDistance : distance;
+            if (top.first > settled[u]) continue;
+
+            if (opposite[u] != infinity() && settled[u] + opposite[u] < best){
+                best = settled[u] + opposite[u];
+                meeting = u;
+            }
+
+            vector<Arc>& arcs = isForward ? up[u] : down[u];
+            for (int k = 0; k < arcs.size(); k++){
+                E candidate = settled[u] + arcs[k].weight;
+                if (candidate < settled[arcs[k].to]){
+                    settled[arcs[k].to] = candidate;
+                    (isForward ? parent : backParent)[arcs[k].to] = {u, k};
+                    queue.push({candidate, arcs[k].to});
+                }
+            }
+        }
+
+        if (meeting == -1)
+            return false;
+
+        vector< pair<int, int> > chain;
+        for (int v = meeting; parent[v].first != -1; v = parent[v].first)
+            chain.push_back(parent[v]);
+        reverse(chain.begin(), chain.end());
+
+        path.assign(1, from);
+        length = best;
+        bandwidth = infinity();
+        for (auto& link : chain){
+            Arc& arc = up[link.first][link.second];
+            bandwidth = min(bandwidth, arc.bandwidth);
+            if (!unpack(link.first, arc, path))
+                return false;
+        }
+        for (int v = meeting; backParent[v].first != -1; v = backParent[v].first){
+            Arc& arc = down[backParent[v].first][backParent[v].second];
+            Arc forwardArc = {backParent[v].first, arc.weight, arc.bandwidth, arc.middle};
+            bandwidth = min(bandwidth, arc.bandwidth);
+            if (!unpack(v, forwardArc, path))
+                return false;
+        }
+        return true;
+    }
+
+    /**
+     * Method that writes the hierarchy in binary form
+     * @param file Output stream
+     */
+    void save(ostream& file){
+        static_assert(is_trivially_copyable<E>::value, "weights must be trivially copyable");
+        int n = rank.size();
+        file.write((char*) &tier, sizeof(tier));
+        file.write((char*) &signature, sizeof(signature));
+        file.write((char*) &n, sizeof(n));
+        file.write((char*) rank.data(), n * sizeof(int));
+        for (int v = 0; v < n; v++){
+            for (vector<Arc>* arcs : {&up[v], &down[v]}){
+                int size = arcs->size();
+                file.write((char*) &size, sizeof(size));
+                file.write((char*) arcs->data(), size * sizeof(Arc));
+            }
+        }
+    }
+
+    /**
+     * Method that reads a hierarchy written by save
+     * @param file Input stream
+     * @param expected Fingerprint of the graph the hierarchy must have been built from
+     * @param vertices Number of vertices of that graph
+     * @return Whether the hierarchy was read completely and belongs to the graph
+     */
+    bool load(istream& file, unsigned long long expected, int vertices){
+        int n = 0;
+        file.read((char*) &tier, sizeof(tier));
+        file.read((char*) &signature, sizeof(signature));
+        file.read((char*) &n, sizeof(n));
+        // Nothing is allocated for an index of another graph or a corrupt header
+        if (!file || signature != expected || n != vertices) return false;
+        rank.resize(n);
+        up.assign(n, vector<Arc>());
+        down.assign(n, vector<Arc>());
+        file.read((char*) rank.data(), n * sizeof(int));
+        vector<bool> ranked(n, false);
+        for (int v = 0; v < n && file; v++){
+            if (rank[v] < 0 || rank[v] >= n || ranked[rank[v]]) return false;
+            ranked[rank[v]] = true;
+        }
+        for (int v = 0; v < n && file; v++){
+            for (vector<Arc>* arcs : {&up[v], &down[v]}){
+                int size = 0;
+                file.read((char*) &size, sizeof(size));
+                if (!file || size < 0 || size > n) return false;
+                arcs->resize(size);
+                file.read((char*) arcs->data(), size * sizeof(Arc));
+                // Arcs lead to higher ranks and bypass lower ones, so unpacking them terminates
+                for (const Arc& arc : *arcs)
+                    if (arc.to < 0 || arc.to >= n || rank[arc.to] <= rank[v] ||
+                        (arc.middle != -1 && (arc.middle < 0 || arc.middle >= n || rank[arc.middle] >= rank[v])))
+                        return false;
+            }
+        }
+        return (bool) file;
+    }
+
+private:
+    /**
+     * Method that appends the original vertices of an arc to the path
+     * @param from Tail of the arc
+     * @param arc Arc leading away from the tail
+     * @param path Path that currently ends with the tail
+     * @return Whether both halves of every shortcut were found
+     */
+    bool unpack(int from, const Arc& arc, vector<int>& path){
+        if (arc.middle == -1){
+            path.push_back(arc.to);
+            return true;
+        }
+        // The bypassed vertex is ranked below both ends, so the first half is stored
+        // reversed among its down arcs and the second half among its up arcs
+        const Arc* first = findArc(down[arc.middle], from);
+        const Arc* second = findArc(up[arc.middle], arc.to);
+        return first && second && unpack(from, {arc.middle, first->weight, first->bandwidth, first->middle}, path)
+               && unpack(arc.middle, *second, path);
+    }
+
+    /**
+     * Method that finds the arc to a vertex
+     * @param arcs Collection of arcs
+     * @param to Vertex
+     * @return Arc, nullptr if there is none
+     */
+    static const Arc* findArc(const vector<Arc>& arcs, int to){
+        for (const Arc& arc : arcs)
+            if (arc.to == to)
+                return &arc;
+        return nullptr;
+    }
+
+    /**
+     * Method that computes the shortcuts needed to contract a vertex
+     * @param v Vertex
+     * @param shortcuts Pairs of a tail and the shortcut leaving it
+     */
+    void findShortcuts(int v, vector< pair<int, Arc> >& shortcuts){
+        shortcuts.clear();
+        for (Arc& incoming : in[v]){
+            int u = incoming.to;
+            E limit = 0;
+            for (Arc& outgoing : out[v])
+                if (outgoing.to != u)
+                    limit = max(limit, incoming.weight + outgoing.weight);
+
+            // Witness search from u that avoids v, bounded in distance and settled vertices
+            vector<int> touched(1, u);
+            distance[u] = 0;
+            Queue queue;
+            queue.push({0, u});
+            int settled = 0;
+            while (!queue.empty() && settled < WITNESS_LIMIT){
+                Item top = queue.top();
+                queue.pop();
+                if (top.first > distance[top.second]) continue;
+                if (top.first > limit) break;
+                settled++;
+                for (Arc& arc : out[top.second]){
+                    if (arc.to == v) continue;
+                    E candidate = top.first + arc.weight;
+                    if (candidate < distance[arc.to]){
+                        if (distance[arc.to] == infinity())
+                            touched.push_back(arc.to);
+                        distance[arc.to] = candidate;
+                        queue.push({candidate, arc.to});
+                    }
+                }
+            }
+
+            for (Arc& outgoing : out[v]){
+                if (outgoing.to == u) continue;
+                E weight = incoming.weight + outgoing.weight;
+                if (distance[outgoing.to] > weight)
+                    shortcuts.push_back({u, {outgoing.to, weight, min(incoming.bandwidth, outgoing.bandwidth), v}});
+            }
+            for (int vertex : touched)
+                distance[vertex] = infinity();
+        }
+    }
+
+    /**
+     * Method that inserts an arc into the remaining graph unless a better one exists
+     * @param from Tail of the arc
+     * @param arc Arc
+     */
+    void addArc(int from, const Arc& arc){
+        for (int k = 0; k < out[from].size(); k++)
+            if (out[from][k].to == arc.to){
+                if (arc.weight >= out[from][k].weight) return;
+                out[from][k] = arc;
+                for (Arc& reversed : in[arc.to])
+                    if (reversed.to == from)
+                        reversed = {from, arc.weight, arc.bandwidth, arc.middle};
+                return;
+            }
+        out[from].push_back(arc);
+        in[arc.to].push_back({from, arc.weight, arc.bandwidth, arc.middle});
+    }
+
+    /**
+     * Method that removes the arc to a vertex
+     * @param arcs Collection of arcs
+     * @param to Vertex
+     */
+    static void removeArc(vector<Arc>& arcs, int to){
+        for (int k = 0; k < arcs.size(); k++)
+            if (arcs[k].to == to){
+                arcs.erase(arcs.begin() + k);
+                return;
+            }
+    }
+};
+
+/**
+ * Class ShortestPathTree
+ * Single-source shortest path tree over the edges whose bandwidth is at least
+ * the tier, repaired incrementally after every change of an edge
+ * @tparam E Type of the weight
+ */
+template<typename E>
+class ShortestPathTree{
+public:
+    int root = 0;               // Source of the tree
+    E tier = 0;                 // Minimum bandwidth of usable edges
+    vector<E> distance;         // Distance from the root to every vertex
+    vector<int> parent;         // Parent of every vertex in the tree, -1 if none
+
+private:
+    vector< vector<int> > children;     // Children of every vertex in the tree
+    vector<bool> affected;              // Vertices of the subtree under repair
+
+    typedef pair<E, int> Item;
+    typedef priority_queue<Item, vector<Item>, greater<Item> > Queue;
+
+    static E infinity(){
+        return numeric_limits<E>::max();
+    }
+
+public:
+    /**
+     * Method that computes the tree from scratch
+     * @param graph Graph
+     * @param from Index of the root
+     * @param W Bandwidth tier
+     */
+    template<typename V>
+    void build(AdjacencyMatrixGraph<V, E>& graph, int from, E W){
+        int n = graph.vertices.size();
+        root = from;
+        tier = W;
+        distance.assign(n, infinity());
+        parent.assign(n, -1);
+        children.assign(n, vector<int>());
+        affected.assign(n, false);
+
+        Queue queue;
+        distance[root] = 0;
+        queue.push({0, root});
+        propagate(graph, queue);
+    }
+
+    /**
+     * Method that repairs the tree after the edge between two vertices
+     * was inserted, removed or changed its weight or bandwidth
+     * @param graph Graph after the change
+     * @param from Index of the source of the edge
+     * @param to Index of the target of the edge
+     */
+    template<typename V>
+    void update(AdjacencyMatrixGraph<V, E>& graph, int from, int to){
+        Edge<E>* edge = graph.edges[from][to];
+        bool usable = isUsable(edge) && from != to;
+
+        // A tree edge that got longer or disappeared invalidates the subtree below it
+        if (parent[to] == from && (!usable || distance[from] + edge->weight != distance[to]))
+            repair(graph, to);
+
+        // An edge that got shorter or appeared can only improve distances behind it
+        if (usable && distance[from] != infinity() && distance[from] + edge->weight < distance[to]){
+            Queue queue;
+            distance[to] = distance[from] + edge->weight;
+            attach(to, from);
+            queue.push({distance[to], to});
+            propagate(graph, queue);
+        }
+    }
+
+    /**
+     * Method that prints the distance to a vertex
+     * @param to Index of vertex
+     */
+    void printDistance(int to){
+        if (distance[to] == infinity())
+            cout << "IMPOSSIBLE" << endl;
+        else
+            cout << distance[to] << endl;
+    }
+
+    /**
+     * Method that prints the tree path to a vertex in the format of dijkstra
+     * @param to Index of vertex
+     * @param graph Graph
+     */
+    template<typename V>
+    void printPath(AdjacencyMatrixGraph<V, E>& graph, int to){
+        if (to == root || distance[to] == infinity()){
+            cout << "IMPOSSIBLE" << endl;
+            return;
+        }
+
+        vector<int> path;
+        E bandwidth = infinity();
+        for (int v = to; v != root; v = parent[v]){
+            path.push_back(v);
+            bandwidth = min(bandwidth, graph.edges[parent[v]][v]->bandwidth);
+        }
+        path.push_back(root);
+
+        cout << path.size() << " " << distance[to] << " " << bandwidth << endl;
+        for (int i = path.size() - 1; i >= 0; i--){
+            cout << graph.vertices[path[i]]->title + 1 << " ";
+        }
+        cout << endl;
+    }
+
+private:
+    bool isUsable(Edge<E>* edge){
+        return !edge->isEmpty && edge->bandwidth >= tier;
+    }
+
+    /**
+     * Method that moves a vertex under a new parent
+     * @param v Vertex
+     * @param p New parent, -1 to detach the vertex
+     */
+    void attach(int v, int p){
+        if (parent[v] != -1){
+            vector<int>& siblings = children[parent[v]];
+            siblings.erase(find(siblings.begin(), siblings.end(), v));
+        }
+        parent[v] = p;
+        if (p != -1)
+            children[p].push_back(v);
+    }
+
+    /**
+     * Method that settles the queued vertices and relaxes edges behind them
+     * @param graph Graph
+     * @param queue Vertices whose distance decreased
+     */
+    template<typename V>
+    void propagate(AdjacencyMatrixGraph<V, E>& graph, Queue& queue){
+        while (!queue.empty()){
+            Item top = queue.top();
+            queue.pop();
+            int u = top.second;
+            if (top.first > distance[u]) continue;
+
+            for (auto neighbour : graph.outNeighbours(u)){
+                int v = neighbour.first;
+                Edge<E>* edge = neighbour.second;
+                if (v == u || !isUsable(edge)) continue;
+                if (distance[u] + edge->weight < distance[v]){
+                    distance[v] = distance[u] + edge->weight;
+                    attach(v, u);
+                    queue.push({distance[v], v});
+                }
+            }
+        }
+    }
+
+    /**
+     * Method that recomputes the distances inside the subtree of a vertex
+     * @param graph Graph
+     * @param v Root of the affected subtree
+     */
+    template<typename V>
+    void repair(AdjacencyMatrixGraph<V, E>& graph, int v){
+        vector<int> subtree(1, v);
+        affected[v] = true;
+        for (int i = 0; i < subtree.size(); i++)
+            for (int child : children[subtree[i]]){
+                affected[child] = true;
+                subtree.push_back(child);
+            }
+
+        attach(v, -1);
+        for (int x : subtree){
+            distance[x] = infinity();
+            parent[x] = -1;
+            children[x].clear();
+        }
+
+        // Every affected vertex starts from its best edge out of the unaffected part
+        Queue queue;
+        for (int x : subtree){
+            for (auto neighbour : graph.inNeighbours(x)){
+                int y = neighbour.first;
+                Edge<E>* edge = neighbour.second;
+                if (affected[y] || !isUsable(edge) || distance[y] == infinity()) continue;
+                if (distance[y] + edge->weight < distance[x]){
+                    distance[x] = distance[y] + edge->weight;
+                    attach(x, y);
+                }
+            }
+            if (distance[x] != infinity())
+                queue.push({distance[x], x});
+        }
+
+        for (int x : subtree)
+            affected[x] = false;
+        propagate(graph, queue);
+    }
+};
+
+/**
+ * Class KShortestPaths
+ * Yen's k shortest loopless paths over the edges whose bandwidth is at least
+ * W. One tree of distances to the target, grown backwards from it, serves
+ * every spur search: a spur vertex whose tree path avoids the blocked vertices
+ * and edges takes that path as it is, the others run A* guided by the tree
+ * distances. The search arrays are stamped per spur instead of cleared.
+ * Lengths must not be negative
+ * @tparam E Type of the weight
+ */
+template<typename E>
+class KShortestPaths{
+public:
+    typedef pair<E, vector<int>> Path;
+
+private:
+    typedef pair<E, int> Item;
+
+    vector<int> start, target;  // Edges of bandwidth at least W by source, taken once per query
+    vector<E> weight;           // Length of every edge of the snapshot
+    vector<E> remaining;        // Distance from every vertex to the target
+    vector<int> next;           // Next vertex on the tree path to the target, -1 for the target and unreached vertices
+    vector<E> length;           // Distance from the spur vertex in the current search
+    vector<int> previous;       // Previous vertex in the current search
+    vector<int> blocked;        // Stamp of the spur that blocks a vertex of its root path
+    vector<int> reached;        // Stamp of the search that reached a vertex
+    vector<int> closed;         // Stamp of the search that settled a vertex
+    int stamp = 0;
+
+    vector<int> treePath(int from){
+        vector<int> path;
+        for (int v = from; v != -1; v = next[v])
+            path.push_back(v);
+        return path;
+    }
+
+    /**
+     * Method that finds the shortest path from a spur vertex to the target
+     * avoiding the blocked vertices and the edges to the cut vertices
+     * @param spur Index of the spur vertex
+     * @param to Index of the target
+     * @param cut Targets of the edges from the spur vertex that may not be taken
+     * @param path Vertices of the path
+     * @param total Length of the path
+     * @return False if the target cannot be reached
+     */
+    bool spurPath(int spur, int to, const vector<int>& cut, vector<int>& path, E& total){
+        auto isCut = [&](int v){ return find(cut.begin(), cut.end(), v) != cut.end(); };
+
+        // No path is shorter than the tree path, so it is taken whenever it is allowed
+        bool clear = !isCut(next[spur]);
+        for (int v = next[spur]; v != -1 && clear; v = next[v])
+            clear = blocked[v] != stamp;
+        if (clear){
+            path = treePath(spur);
+            total = remaining[spur];
+            return true;
+        }
+
+        priority_queue<Item, vector<Item>, greater<Item>> queue;
+        length[spur] = 0;
+        previous[spur] = -1;
+        reached[spur] = stamp;
+        queue.push({remaining[spur], spur});
+        while (!queue.empty()){
+            int u = queue.top().second;
+            queue.pop();
+            if (closed[u] == stamp) continue;
+            closed[u] = stamp;
+            if (u == to){
+                path.clear();
+                for (int v = to; v != -1; v = previous[v])
+                    path.push_back(v);
+                reverse(path.begin(), path.end());
+                total = length[to];
+                return true;
+            }
+
+            for (int e = start[u]; e < start[u + 1]; e++){
+                int v = target[e];
+                if (blocked[v] == stamp || closed[v] == stamp) continue;
+                if (remaining[v] == WeightTraits<E>::infinity() || (u == spur && isCut(v))) continue;
+                E candidate = length[u] + weight[e];
+                if (reached[v] == stamp && !(candidate < length[v])) continue;
+                reached[v] = stamp;
+                length[v] = candidate;
+                previous[v] = u;
+                queue.push({candidate + remaining[v], v});
+            }
+        }
+        return false;
+    }
+
+public:
+    /**
+     * Method that finds the shortest loopless paths between two vertices
+     * @param graph Graph
+     * @param from Index of the source
+     * @param to Index of the target
+     * @param W Bandwidth
+     * @param k Number of paths
+     * @return Up to k paths with their lengths, shortest first
+     */
+    template<typename V>
+    vector<Path> search(AdjacencyMatrixGraph<V, E>& graph, int from, int to, E W, int k){
+        int n = graph.vertices.size();
+        vector<Path> found;
+        AdjacencyMatrixGraph<V, E>::distances(n, to, W, [&graph](int u){ return graph.inNeighbours(u); },
+                                              remaining, next);
+        if (from == to || k <= 0 || remaining[from] == WeightTraits<E>::infinity())
+            return found;
+
+        start.assign(n + 1, 0);
+        target.clear();
+        weight.clear();
+        for (int u = 0; u < n; u++){
+            for (auto neighbour : graph.outNeighbours(u))
+                if (neighbour.second->bandwidth >= W){
+                    target.push_back(neighbour.first);
+                    weight.push_back(neighbour.second->weight);
+                }
+            start[u + 1] = target.size();
+        }
+        length.assign(n, 0);
+        previous.assign(n, -1);
+        blocked.assign(n, 0);
+        reached.assign(n, 0);
+        closed.assign(n, 0);
+        stamp = 0;
+
+        set<Path> candidates;
+        found.push_back({remaining[from], treePath(from)});
+        while (found.size() < k){
+            vector<int> last = found.back().second;
+            E rootLength = 0;
+
+            // Every vertex of the last path but the target deviates from it in turn
+            for (int i = 0; i + 1 < last.size(); i++){
+                int spur = last[i];
+                stamp++;
+                for (int j = 0; j < i; j++)
+                    blocked[last[j]] = stamp;
+                vector<int> cut;
+                for (auto& path : found)
+                    if (path.second.size() > i + 1 && equal(last.begin(), last.begin() + i + 1, path.second.begin()))
+                        cut.push_back(path.second[i + 1]);
+
+                vector<int> deviation;
+                E spurLength;
+                if (spurPath(spur, to, cut, deviation, spurLength)){
+                    vector<int> candidate(last.begin(), last.begin() + i);
+                    candidate.insert(candidate.end(), deviation.begin(), deviation.end());
+                    candidates.insert({rootLength + spurLength, candidate});
+                }
+                rootLength += graph.edges[spur][last[i + 1]]->weight;
+            }
+
+            if (candidates.empty()) break;
+            found.push_back(*candidates.begin());
+            candidates.erase(candidates.begin());
+        }
+        return found;
+    }
+};
+
+/**
+ * Class CompressedGraph
+ * Frozen copy of the graph for read-mostly use. The sorted neighbour list of
+ * every vertex is gap-encoded with variable-length integers and may copy
+ * neighbours from the list of a recent vertex in the WebGraph style; the
+ * length and bandwidth of every edge follow its vertex's list
+ * @tparam E Type of the weight
+ */
+template<typename E>
+class CompressedGraph{
+public:
+    /**
+     * Decoded edge
+     */
+    struct Arc{
+        int to;
+        E weight;
+        E bandwidth;
+    };
+
+    int version = -1;                   // Version of the graph the copy was taken from
+    int window = 0;                     // Previous lists considered as references, 0 for none
+    long long edgeCount = 0;            // Number of edges
+    size_t topologyBytes = 0;           // Bytes spent on the neighbour lists
+
+private:
+    static const int MAX_CHAIN = 3;     // Longest chain of references, bounds the decoding work
+
+    vector<uint8_t> bytes;              // Encoded vertices
+    vector<uint32_t> offsets;           // Position of every vertex in bytes
+    vector< vector<int> > scratch;      // Decoded reference lists, one per level of the chain
+
+    static E infinity(){
+        return numeric_limits<E>::max();
+    }
+
+public:
+    int size(){
+        return (int) offsets.size() - 1;
+    }
+
+    /**
+     * Method that encodes the graph
+     * @param graph Graph
+     * @param references Previous lists considered as references, 0 for none
+     */
+    template<typename V>
+    void build(AdjacencyMatrixGraph<V, E>& graph, int references){
+        int n = graph.vertices.size();
+        version = graph.version;
+        window = max(references, 0);
+        edgeCount = 0;
+        topologyBytes = 0;
+        bytes.clear();
+        offsets.assign(1, 0);
+
+        vector< vector<int> > lists(n);
+        vector<int> chain(n, 0);
+        for (int v = 0; v < n; v++)
+            for (auto neighbour : graph.outNeighbours(v))
+                lists[v].push_back(neighbour.first);
+
+        vector<uint8_t> candidate, best;
+        for (int v = 0; v < n; v++){
+            const vector<int>& list = lists[v];
+            edgeCount += list.size();
+
+            // The reference giving the shortest encoding wins, no reference is a candidate too
+            best.clear();
+            encode(v, list, lists, 0, best);
+            int reference = 0;
+            for (int r = 1; r <= window && r <= v; r++){
+                if (chain[v - r] >= MAX_CHAIN || intersection(list, lists[v - r]) == 0) continue;
+                candidate.clear();
+                encode(v, list, lists, r, candidate);
+                if (candidate.size() < best.size()){
+                    best.swap(candidate);
+                    reference = r;
+                }
+            }
+            if (reference != 0)
+                chain[v] = chain[v - reference] + 1;
+            bytes.insert(bytes.end(), best.begin(), best.end());
+            topologyBytes += best.size();
+
+            for (int to : list){
+                put(bytes, zigzag(graph.edges[v][to]->weight));
+                put(bytes, zigzag(graph.edges[v][to]->bandwidth));
+            }
+            offsets.push_back(bytes.size());
+        }
+        scratch.assign(MAX_CHAIN + 1, vector<int>());
+    }
+
+    /**
+     * Method that decodes the edges going from a vertex
+     * @param v Index of vertex
+     * @param arcs Buffer receiving the edges in the order of their targets
+     */
+    void neighbours(int v, vector<Arc>& arcs){
+        size_t position = offsets[v];
+        vector<int>& list = scratch[0];
+        decode(v, position, 0);
+        arcs.resize(list.size());
+        for (size_t k = 0; k < list.size(); k++){
+            arcs[k].to = list[k];
+            arcs[k].weight = unzigzag(get(position));
+            arcs[k].bandwidth = unzigzag(get(position));
+        }
+    }
+
+    /**
+     * Method that visits the vertices reachable over edges with enough bandwidth
+     * @param from Index of vertex
+     * @param W Bandwidth
+     * @param depthFirst Whether to search depth-first instead of breadth-first
+     * @return Number of visited vertices
+     */
+    int traverse(int from, E W, bool depthFirst){
+        vector<bool> seen(size(), false);
+        vector<int> pending(1, from);
+        vector<Arc> arcs;
+        seen[from] = true;
+        int visited = 0;
+        for (size_t head = 0; depthFirst ? !pending.empty() : head < pending.size(); visited++){
+            int v;
+            if (depthFirst){
+                v = pending.back();
+                pending.pop_back();
+            }
+            else
+                v = pending[head++];
+            neighbours(v, arcs);
+            for (auto& arc : arcs)
+                if (arc.bandwidth >= W && !seen[arc.to]){
+                    seen[arc.to] = true;
+                    pending.push_back(arc.to);
+                }
+        }
+        return visited;
+    }
+
+    /**
+     * Method that computes shortest paths from a vertex over edges with enough bandwidth
+     * @param from Index of vertex
+     * @param W Bandwidth
+     * @param distance Distance to every vertex, infinity if unreachable
+     * @param parent Previous vertex on the path to every vertex, -1 if none
+     * @param through Bottleneck bandwidth of the path to every vertex
+     */
+    void dijkstra(int from, E W, vector<E>& distance, vector<int>& parent, vector<E>& through){
+        typedef pair<E, int> Item;
+        priority_queue<Item, vector<Item>, greater<Item> > queue;
+        distance.assign(size(), infinity());
+        parent.assign(size(), -1);
+        through.assign(size(), infinity());
+        vector<Arc> arcs;
+
+        distance[from] = 0;
+        queue.push({0, from});
+        while (!queue.empty()){
+            Item top = queue.top();
+            queue.pop();
+            int u = top.second;
+            if (top.first > distance[u]) continue;
+            neighbours(u, arcs);
+            for (auto& arc : arcs)
+                if (arc.bandwidth >= W && arc.to != u && distance[u] + arc.weight < distance[arc.to]){
+                    distance[arc.to] = distance[u] + arc.weight;
+                    parent[arc.to] = u;
+                    through[arc.to] = min(through[u], arc.bandwidth);
+                    queue.push({distance[arc.to], arc.to});
+                }
+        }
+    }
+
+    /**
+     * Method that prints the shortest path in the format of dijkstra
+     * @param graph Graph the copy was taken from, naming the vertices
+     * @param from Index of vertex
+     * @param to Index of vertex
+     * @param W Bandwidth
+     */
+    template<typename V>
+    void route(AdjacencyMatrixGraph<V, E>& graph, int from, int to, E W){
+        vector<E> distance, through;
+        vector<int> parent;
+        dijkstra(from, W, distance, parent, through);
+        if (from == to || distance[to] == infinity()){
+            cout << "IMPOSSIBLE" << endl;
+            return;
+        }
+
+        vector<int> path;
+        for (int v = to; v != -1; v = parent[v])
+            path.push_back(v);
+        cout << path.size() << " " << distance[to] << " " << through[to] << endl;
+        for (int i = path.size() - 1; i >= 0; i--)
+            cout << graph.vertices[path[i]]->title + 1 << " ";
+        cout << endl;
+    }
+
+    /**
+     * Method that prints the space taken per edge
+     */
+    void printSize(){
+        double edges = max(edgeCount, 1LL);
+        cout << "vertices " << size() << " edges " << edgeCount
+             << " topology_bits_per_edge " << 8.0 * topologyBytes / edges
+             << " total_bits_per_edge " << 8.0 * (bytes.size() + offsets.size() * sizeof(uint32_t)) / edges << endl;
+    }
+
+private:
+    static unsigned long long zigzag(long long x){
+        return ((unsigned long long) x << 1) ^ (unsigned long long) (x >> 63);
+    }
+
+    static long long unzigzag(unsigned long long x){
+        return (long long) (x >> 1) ^ -(long long) (x & 1);
+    }
+
+    /**
+     * Method that appends a variable-length integer, seven bits per byte
+     * @param out Buffer
+     * @param x Value
+     */
+    static void put(vector<uint8_t>& out, unsigned long long x){
+        while (x >= 0x80){
+            out.push_back(x | 0x80);
+            x >>= 7;
+        }
+        out.push_back(x);
+    }
+
+    /**
+     * Method that encodes a neighbour list
+     * @param v Index of vertex
+     * @param list Sorted neighbours of the vertex
+     * @param lists Sorted neighbours of all vertices
+     * @param reference Distance back to the reference list, 0 for none
+     * @param out Buffer receiving the encoding
+     */
+    static void encode(int v, const vector<int>& list, const vector< vector<int> >& lists, int reference,
+                       vector<uint8_t>& out){
+        put(out, list.size());
+        put(out, reference);
+        vector<int> residuals;
+        if (reference == 0)
+            residuals = list;
+        else{
+            // Alternating runs of copied and skipped neighbours of the reference, the last one implicit
+            const vector<int>& base = lists[v - reference];
+            vector<int> runs(1, 0);
+            size_t i = 0;
+            for (size_t k = 0; k < base.size(); k++){
+                while (i < list.size() && list[i] < base[k])
+                    i++;
+                bool copied = i < list.size() && list[i] == base[k];
+                if (copied != (runs.size() % 2 == 1))
+                    runs.push_back(0);
+                runs.back()++;
+            }
+            runs.pop_back();
+            put(out, runs.size());
+            for (int run : runs)
+                put(out, run);
+
+            for (size_t k = 0, j = 0; k < list.size(); k++){
+                while (j < base.size() && base[j] < list[k])
+                    j++;
+                if (j == base.size() || base[j] != list[k])
+                    residuals.push_back(list[k]);
+            }
+        }
+
+        for (size_t k = 0; k < residuals.size(); k++)
+            put(out, k == 0 ? zigzag(residuals[k] - v) : residuals[k] - residuals[k - 1] - 1);
+    }
+
+    unsigned long long get(size_t& position){
+        unsigned long long x = 0;
+        for (int shift = 0; ; shift += 7){
+            uint8_t byte = bytes[position++];
+            x |= (unsigned long long) (byte & 0x7f) << shift;
+            if (byte < 0x80)
+                return x;
+        }
+    }
+
+    static int intersection(const vector<int>& a, const vector<int>& b){
+        int common = 0;
+        for (size_t i = 0, j = 0; i < a.size() && j < b.size();){
+            if (a[i] == b[j]){
+                common++;
+                i++;
+                j++;
+            }
+            else if (a[i] < b[j])
+                i++;
+            else
+                j++;
+        }
+        return common;
+    }
+
+    /**
+     * Method that decodes the neighbour list of a vertex into scratch[level]
+     * @param v Index of vertex
+     * @param position Position of the list, moved past it
+     * @param level Depth in the chain of references
+     */
+    void decode(int v, size_t& position, int level){
+        vector<int>& list = scratch[level];
+        list.clear();
+        int degree = get(position);
+        int reference = get(position);
+
+        if (reference != 0){
+            size_t referencePosition = offsets[v - reference];
+            decode(v - reference, referencePosition, level + 1);
+            const vector<int>& base = scratch[level + 1];
+            int blocks = get(position);
+            size_t k = 0;
+            for (int b = 0; b < blocks; b++){
+                int run = get(position);
+                if (b % 2 == 0)
+                    list.insert(list.end(), base.begin() + k, base.begin() + k + run);
+                k += run;
+            }
+            if (blocks % 2 == 0)
+                list.insert(list.end(), base.begin() + k, base.end());
+        }
+
+        // Residuals are merged into the copied neighbours, keeping the list sorted
+        size_t copied = list.size();
+        int previous = v;
+        for (size_t k = copied; k < degree; k++){
+            previous = k == copied ? v + unzigzag(get(position)) : previous + get(position) + 1;
+            list.push_back(previous);
+        }
+        inplace_merge(list.begin(), list.begin() + copied, list.end());
+    }
+};
+
+/**
+ * Class PartitionedGraph
+ * Graph hash-partitioned by vertex across worker processes that run vertex
+ * programs in supersteps, exchanging messages in one batch per worker
+ * through the coordinator over Unix sockets
+ * @tparam E Type of the weight
+ */
+template<typename E>
+class PartitionedGraph{
+public:
+    enum Operation {SHORTEST, HOPS, TRIM, COLLECT, STOP};
+
+    /**
+     * Message to a vertex. Searches offer a path through the parent,
+     * trimming reports lost predecessors (parent -1) or successors
+     * (parent -2) with their number in hops
+     */
+    struct Message{
+        int vertex;
+        int parent;
+        E distance;
+        int hops;
+    };
+
+    /**
+     * State of an owned vertex reported to the coordinator
+     */
+    struct State{
+        int vertex;
+        int parent;
+        int hops;
+        bool alive;
+    };
+
+    int workers = 0;            // Number of running worker processes
+    int version = -1;           // Version of the graph the shards were cut from
+    int supersteps = 0;         // Supersteps of the last run
+    long long messages = 0;     // Messages exchanged during the last run
+    bool overflow = false;      // Whether the last search hit a negative cycle
+
+private:
+    struct Header{
+        int operation;
+        int superstep;
+        E bound;
+        int count;
+        bool overflow;
+    };
+
+    struct Arc{
+        int to;
+        E weight;
+        E bandwidth;
+    };
+
+    int size = 0;               // Number of vertices
+    vector<int> sockets;        // Coordinator ends of the sockets, one per worker
+    vector<pid_t> pids;         // Worker processes
+
+    // Shard of a worker, filled in the child process only
+    vector<int> owned;                  // Vertices of the shard
+    vector<int> slot;                   // Position of an owned vertex in the shard
+    vector< vector<Arc> > out;          // Outgoing edges of the owned vertices
+    vector< vector<Arc> > in;           // Incoming edges of the owned vertices, reversed
+    vector<Message> state;              // Best offer accepted by every owned vertex
+    vector<int> degree[2];              // Live incoming and outgoing edges while trimming
+    vector<bool> alive;                 // Whether a vertex survived trimming
+    vector<bool> improved;              // Whether a vertex accepted an offer this superstep
+    vector<int> combined;               // Outbox position of the message to a vertex and kind
+    vector<Message> outbox;             // Combined messages of the superstep
+
+public:
+    PartitionedGraph() = default;
+    PartitionedGraph(const PartitionedGraph&) = delete;
+    PartitionedGraph& operator=(const PartitionedGraph&) = delete;
+
+    ~PartitionedGraph(){
+        stop();
+    }
+
+    /**
+     * Method that determines the worker owning a vertex
+     * @param v Index of vertex
+     * @param workers Number of workers
+     * @return Index of the worker
+     */
+    static int owner(int v, int workers){
+        return (unsigned) v * 2654435761u % workers;
+    }
+
+    /**
+     * Method that cuts the graph into shards and forks one worker per shard
+     * @param graph Graph
+     * @param count Number of workers
+     */
+    template<typename V>
+    void start(AdjacencyMatrixGraph<V, E>& graph, int count){
+        stop();
+        size = graph.vertices.size();
+        version = graph.version;
+        cout.flush();
+
+        for (int w = 0; w < count; w++){
+            int ends[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, ends) != 0)
+                break;
+            pid_t pid = fork();
+            if (pid < 0){
+                close(ends[0]);
+                close(ends[1]);
+                break;
+            }
+            if (pid == 0){
+                close(ends[0]);
+                for (int s : sockets)
+                    close(s);
+                cut(graph, w, count);
+                serve(ends[1]);
+                _exit(0);
+            }
+            close(ends[1]);
+            sockets.push_back(ends[0]);
+            pids.push_back(pid);
+        }
+        workers = sockets.size();
+
+        // Every worker reports once its shard is cut
+        Header header;
+        for (int s : sockets)
+            transfer(s, &header, sizeof(header), false);
+    }
+
+    /**
+     * Method that stops the workers
+     */
+    void stop(){
+        Header header = {STOP, 0, 0, 0, false};
+        for (int s : sockets){
+            transfer(s, &header, sizeof(header), true);
+            close(s);
+        }
+        for (pid_t pid : pids)
+            waitpid(pid, nullptr, 0);
+        sockets.clear();
+        pids.clear();
+        workers = 0;
+    }
+
+    /**
+     * Method that runs a vertex program until no messages are left
+     * @param operation SHORTEST, HOPS or TRIM
+     * @param W Bandwidth
+     * @param initial Messages delivered in the first superstep
+     */
+    void run(Operation operation, E W, const vector<Message>& initial){
+        vector< vector<Message> > boxes(workers);
+        for (auto& message : initial)
+            boxes[owner(message.vertex, workers)].push_back(message);
+
+        supersteps = 0;
+        messages = 0;
+        overflow = false;
+        for (long long sent = 1; sent > 0; supersteps++){
+            for (int w = 0; w < workers; w++){
+                Header header = {operation, supersteps, W, (int) boxes[w].size(), false};
+                transfer(sockets[w], &header, sizeof(header), true);
+                transfer(sockets[w], boxes[w].data(), boxes[w].size() * sizeof(Message), true);
+                boxes[w].clear();
+            }
+
+            // Barrier: every worker answers with its whole outbox
+            sent = 0;
+            vector<Message> batch;
+            for (int w = 0; w < workers; w++){
+                Header header = {STOP, 0, 0, 0, false};
+                if (!transfer(sockets[w], &header, sizeof(header), false))
+                    continue;
+                batch.resize(header.count);
+                transfer(sockets[w], batch.data(), batch.size() * sizeof(Message), false);
+                for (auto& message : batch)
+                    boxes[owner(message.vertex, workers)].push_back(message);
+                sent += header.count;
+                overflow = overflow || header.overflow;
+            }
+            messages += sent;
+        }
+    }
+
+    /**
+     * Method that gathers the states of all vertices after a run
+     * @return State of every vertex by index
+     */
+    vector<State> collect(){
+        vector<State> states(size, State{-1, -1, -1, false});
+        for (int w = 0; w < workers; w++){
+            Header header = {COLLECT, 0, 0, 0, false};
+            transfer(sockets[w], &header, sizeof(header), true);
+            if (!transfer(sockets[w], &header, sizeof(header), false))
+                continue;
+            vector<State> batch(header.count);
+            transfer(sockets[w], batch.data(), batch.size() * sizeof(State), false);
+            for (auto& s : batch)
+                states[s.vertex] = s;
+        }
+        return states;
+    }
+
+    /**
+     * Method that prints a path found by a distributed search in the format of dijkstra
+     * @param graph Graph
+     * @param operation SHORTEST for the shortest path, HOPS for the fewest edges
+     * @param from Index of vertex
+     * @param to Index of vertex
+     * @param W Bandwidth
+     */
+    template<typename V>
+    void path(AdjacencyMatrixGraph<V, E>& graph, Operation operation, int from, int to, E W){
+        run(operation, W, {Message{from, -1, 0, 0}});
+        vector<State> states = collect();
+        if (from == to || overflow || states[to].hops == -1){
+            cout << "IMPOSSIBLE" << endl;
+            return;
+        }
+
+        vector<int> parent(size, -1);
+        E length = 0;
+        for (int v = to; v != from; v = states[v].parent){
+            parent[v] = states[v].parent;
+            length += graph.edges[parent[v]][v]->weight;
+        }
+        graph.printPath(parent, to, length);
+    }
+
+    /**
+     * Method that prints the vertices left after repeatedly removing those
+     * without incoming or outgoing edges, which contain every cycle
+     * @param graph Graph the shards were cut from, naming the vertices
+     * @param W Bandwidth
+     */
+    template<typename V>
+    void cyclicCore(AdjacencyMatrixGraph<V, E>& graph, E W){
+        run(TRIM, W, {});
+        vector<int> core;
+        for (auto& s : collect())
+            if (s.alive)
+                core.push_back(s.vertex);
+
+        if (core.empty()){
+            cout << "ACYCLIC" << endl;
+            return;
+        }
+        cout << core.size() << endl;
+        for (int v : core)
+            cout << graph.vertices[v]->title + 1 << " ";
+        cout << endl;
+    }
+
+private:
+    /**
+     * Method that reads or writes a whole buffer
+     * @param socket Socket
+     * @param data Buffer
+     * @param length Number of bytes
+     * @param sending Whether to write
+     * @return Whether the whole buffer was transferred
+     */
+    static bool transfer(int socket, void* data, size_t length, bool sending){
+        char* bytes = (char*) data;
+        while (length > 0){
+            ssize_t done = sending ? send(socket, bytes, length, MSG_NOSIGNAL) : recv(socket, bytes, length, 0);
+            if (done <= 0)
+                return false;
+            bytes += done;
+            length -= done;
+        }
+        return true;
+    }
+
+    /**
+     * Method that keeps the edges of the vertices owned by a worker
+     * @param graph Graph
+     * @param worker Index of the worker
+     * @param count Number of workers
+     */
+    template<typename V>
+    void cut(AdjacencyMatrixGraph<V, E>& graph, int worker, int count){
+        slot.assign(size, -1);
+        for (int v = 0; v < size; v++)
+            if (owner(v, count) == worker){
+                slot[v] = owned.size();
+                owned.push_back(v);
+            }
+
+        out.resize(owned.size());
+        in.resize(owned.size());
+        for (int i = 0; i < owned.size(); i++){
+            for (auto neighbour : graph.outNeighbours(owned[i]))
+                out[i].push_back({neighbour.first, neighbour.second->weight, neighbour.second->bandwidth});
+            for (auto neighbour : graph.inNeighbours(owned[i]))
+                in[i].push_back({neighbour.first, neighbour.second->weight, neighbour.second->bandwidth});
+        }
+        combined.assign(2 * size, -1);
+    }
+
+    /**
+     * Method that answers the coordinator until it stops the worker
+     * @param socket Worker end of the socket
+     */
+    void serve(int socket){
+        Header header = {STOP, 0, 0, 0, false};
+        vector<Message> inbox;
+        transfer(socket, &header, sizeof(header), true);
+        while (transfer(socket, &header, sizeof(header), false) && header.operation != STOP){
+            if (header.operation == COLLECT){
+                vector<State> states;
+                for (int i = 0; i < owned.size(); i++)
+                    states.push_back({owned[i], state[i].parent, state[i].hops, alive[i]});
+                header.count = states.size();
+                transfer(socket, &header, sizeof(header), true);
+                transfer(socket, states.data(), states.size() * sizeof(State), true);
+                continue;
+            }
+
+            inbox.resize(header.count);
+            transfer(socket, inbox.data(), inbox.size() * sizeof(Message), false);
+            header.overflow = false;
+            if (header.operation == TRIM)
+                trim(header, inbox);
+            else
+                relax(header, inbox);
+
+            header.count = outbox.size();
+            transfer(socket, &header, sizeof(header), true);
+            transfer(socket, outbox.data(), outbox.size() * sizeof(Message), true);
+            for (auto& message : outbox)
+                combined[2 * message.vertex + (message.parent == -2)] = -1;
+            outbox.clear();
+        }
+        close(socket);
+    }
+
+    /**
+     * Method that compares two offers of a path to the same vertex
+     * @param a Offer
+     * @param b Offer
+     * @param operation SHORTEST or HOPS
+     * @return Whether a is better than b
+     */
+    static bool better(const Message& a, const Message& b, int operation){
+        if (b.hops == -1)
+            return true;
+        if (operation == SHORTEST && a.distance != b.distance)
+            return a.distance < b.distance;
+        if (a.hops != b.hops)
+            return a.hops < b.hops;
+        return a.parent < b.parent;
+    }
+
+    /**
+     * Method that queues a message, keeping only the best offer or the
+     * total count per vertex and kind
+     * @param message Message
+     * @param operation Running operation
+     */
+    void offer(const Message& message, int operation){
+        int& position = combined[2 * message.vertex + (message.parent == -2)];
+        if (position == -1){
+            position = outbox.size();
+            outbox.push_back(message);
+        }
+        else if (operation == TRIM)
+            outbox[position].hops += message.hops;
+        else if (better(message, outbox[position], operation))
+            outbox[position] = message;
+    }
+
+    /**
+     * Superstep of the shortest path and breadth-first searches: vertices
+     * that accepted a better offer pass it on along their edges
+     * @param header Header of the superstep
+     * @param inbox Delivered messages
+     */
+    void relax(Header& header, const vector<Message>& inbox){
+        if (header.superstep == 0){
+            state.assign(owned.size(), Message{-1, -1, 0, -1});
+            alive.assign(owned.size(), false);
+            improved.assign(owned.size(), false);
+        }
+
+        vector<int> senders;
+        for (auto& message : inbox){
+            int i = slot[message.vertex];
+            if (!better(message, state[i], header.operation))
+                continue;
+            // A simple path has fewer edges than vertices, a longer one can only win around a negative cycle
+            if (message.hops >= size){
+                header.overflow = true;
+                continue;
+            }
+            if (!improved[i])
+                senders.push_back(i);
+            improved[i] = true;
+            state[i] = message;
+        }
+
+        for (int i : senders){
+            improved[i] = false;
+            for (auto& arc : out[i])
+                if (arc.bandwidth >= header.bound && arc.to != owned[i])
+                    offer({arc.to, owned[i], state[i].distance + arc.weight, state[i].hops + 1}, header.operation);
+        }
+    }
+
+    /**
+     * Superstep of trimming: vertices left without live incoming or outgoing
+     * edges die and notify their neighbours
+     * @param header Header of the superstep
+     * @param inbox Delivered messages
+     */
+    void trim(Header& header, const vector<Message>& inbox){
+        vector<int> candidates;
+        if (header.superstep == 0){
+            state.assign(owned.size(), Message{-1, -1, 0, -1});
+            alive.assign(owned.size(), true);
+            degree[0].assign(owned.size(), 0);
+            degree[1].assign(owned.size(), 0);
+            for (int i = 0; i < owned.size(); i++){
+                for (auto& arc : in[i])
+                    degree[0][i] += arc.bandwidth >= header.bound;
+                for (auto& arc : out[i])
+                    degree[1][i] += arc.bandwidth >= header.bound;
+                candidates.push_back(i);
+            }
+        }
+
+        for (auto& message : inbox){
+            int i = slot[message.vertex];
+            degree[message.parent == -2][i] -= message.hops;
+            candidates.push_back(i);
+        }
+
+        for (int i : candidates){
+            if (!alive[i] || (degree[0][i] > 0 && degree[1][i] > 0))
+                continue;
+            alive[i] = false;
+            for (auto& arc : out[i])
+                if (arc.bandwidth >= header.bound)
+                    offer({arc.to, -1, 0, 1}, TRIM);
+            for (auto& arc : in[i])
+                if (arc.bandwidth >= header.bound)
+                    offer({arc.to, -2, 0, 1}, TRIM);
+        }
+    }
+};
+
+/**
+ * Class FrontierSearch
+ * Direction-optimising breadth-first search over a snapshot of the edges.
+ * A step expands the frontier top-down along out-edges while it is small and
+ * bottom-up, letting every unvisited vertex look for a parent among its
+ * in-edges, while it is large. Frontiers and visited sets are bitsets, and
+ * every step is split between threads by words of the bitsets
+ * @tparam E Type of the weight
+ */
+template<typename E>
+class FrontierSearch{
+public:
+    enum Strategy {TOP_DOWN, BOTTOM_UP, HYBRID};
+
+    int version = -1;                   // Version of the graph the snapshot was taken from
+    int threads = max(1, (int) thread::hardware_concurrency());
+    int topDownSteps = 0;               // Steps of the last search taken top-down
+    int bottomUpSteps = 0;              // Steps of the last search taken bottom-up
+
+private:
+    typedef uint64_t Word;
+    static const int BITS = 64;
+    static const int ALPHA = 14;        // Bottom-up once the frontier has more than 1/ALPHA of the unexplored edges
+    static const int BETA = 24;         // Top-down again once a shrinking frontier has fewer than 1/BETA of the vertices
+
+    int n = 0;
+    vector<int> outStart, outTarget;    // Out-edges of every vertex
+    vector<E> outBandwidth;
+    vector<int> inStart, inSource;      // In-edges of every vertex
+    vector<E> inBandwidth;
+
+    /**
+     * Method that runs body(part, begin, end) over the parts of a range, one thread per part
+     * @param count Size of the range
+     * @param body Work on a part
+     * @return Number of parts
+     */
+    template<typename Body>
+    int parallel(int count, Body body){
+        int parts = max(1, min(threads, count));
+        int chunk = (count + parts - 1) / max(parts, 1);
+        if (parts == 1){
+            body(0, 0, count);
+            return 1;
+        }
+        vector<thread> pool;
+        for (int part = 0; part < parts; part++)
+            pool.emplace_back(body, part, min(count, part * chunk), min(count, (part + 1) * chunk));
+        for (auto& worker : pool)
+            worker.join();
+        return parts;
+    }
+
+public:
+    /**
+     * Method that takes the snapshot of the graph
+     * @param graph Graph
+     */
+    template<typename V>
+    void build(AdjacencyMatrixGraph<V, E>& graph){
+        n = graph.vertices.size();
+        version = graph.version;
+        outStart.assign(n + 1, 0);
+        inStart.assign(n + 1, 0);
+        outTarget.clear();
+        outBandwidth.clear();
+        for (int u = 0; u < n; u++){
+            for (auto neighbour : graph.outNeighbours(u)){
+                outTarget.push_back(neighbour.first);
+                outBandwidth.push_back(neighbour.second->bandwidth);
+                inStart[neighbour.first + 1]++;
+            }
+            outStart[u + 1] = outTarget.size();
+        }
+        for (int v = 0; v < n; v++)
+            inStart[v + 1] += inStart[v];
+        inSource.resize(outTarget.size());
+        inBandwidth.resize(outTarget.size());
+        vector<int> position(inStart.begin(), inStart.end() - 1);
+        for (int u = 0; u < n; u++)
+            for (int i = outStart[u]; i < outStart[u + 1]; i++){
+                inSource[position[outTarget[i]]] = u;
+                inBandwidth[position[outTarget[i]]++] = outBandwidth[i];
+            }
+    }
+
+    /**
+     * Method that finds the number of edges on the fewest-edge path to every vertex
+     * @param from Index of vertex
+     * @param W Bandwidth
+     * @param strategy Direction of the steps, HYBRID switches between both
+     * @return Hops to every vertex, -1 where unreachable
+     */
+    vector<int> search(int from, E W, Strategy strategy = HYBRID){
+        int words = (n + BITS - 1) / BITS;
+        vector< atomic<Word> > frontier(words), next(words), visited(words);
+        for (int w = 0; w < words; w++){
+            frontier[w].store(0, memory_order_relaxed);
+            visited[w].store(0, memory_order_relaxed);
+        }
+        vector<int> hops(n, -1);
+        topDownSteps = bottomUpSteps = 0;
+
+        hops[from] = 0;
+        frontier[from / BITS].store(Word(1) << (from % BITS));
+        visited[from / BITS].store(Word(1) << (from % BITS));
+        long long frontierSize = 1;
+        long long frontierEdges = outStart[from + 1] - outStart[from];
+        long long unexplored = (long long) outTarget.size() - frontierEdges;
+        bool bottomUp = strategy == BOTTOM_UP;
+        bool growing = true;
+        vector<long long> found(threads), foundEdges(threads);
+
+        for (int level = 0; frontierSize > 0; level++){
+            if (strategy == HYBRID){
+                if (!bottomUp && frontierEdges > unexplored / ALPHA)
+                    bottomUp = true;
+                else if (bottomUp && !growing && frontierSize < n / BETA)
+                    bottomUp = false;
+            }
+            for (int w = 0; w < words; w++)
+                next[w].store(0, memory_order_relaxed);
+            fill(found.begin(), found.end(), 0);
+            fill(foundEdges.begin(), foundEdges.end(), 0);
+
+            if (bottomUp){
+                bottomUpSteps++;
+                parallel(words, [&](int part, int begin, int end){
+                    for (int w = begin; w < end; w++){
+                        Word unvisited = ~visited[w].load(memory_order_relaxed);
+                        if (w == words - 1 && n % BITS)
+                            unvisited &= (Word(1) << (n % BITS)) - 1;
+                        Word reached = 0;
+                        for (; unvisited; unvisited &= unvisited - 1){
+                            int v = w * BITS + __builtin_ctzll(unvisited);
+                            for (int i = inStart[v]; i < inStart[v + 1]; i++){
+                                int u = inSource[i];
+                                if (inBandwidth[i] < W || !(frontier[u / BITS].load(memory_order_relaxed) >> (u % BITS) & 1))
+                                    continue;
+                                reached |= Word(1) << (v % BITS);
+                                hops[v] = level + 1;
+                                found[part]++;
+                                foundEdges[part] += outStart[v + 1] - outStart[v];
+                                break;
+                            }
+                        }
+                        next[w].store(reached, memory_order_relaxed);
+                        visited[w].fetch_or(reached, memory_order_relaxed);
+                    }
+                });
+            }
+            else{
+                topDownSteps++;
+                parallel(words, [&](int part, int begin, int end){
+                    for (int w = begin; w < end; w++)
+                        for (Word bits = frontier[w].load(memory_order_relaxed); bits; bits &= bits - 1){
+                            int u = w * BITS + __builtin_ctzll(bits);
+                            for (int i = outStart[u]; i < outStart[u + 1]; i++){
+                                int v = outTarget[i];
+                                Word mask = Word(1) << (v % BITS);
+                                if (outBandwidth[i] < W || visited[v / BITS].load(memory_order_relaxed) & mask)
+                                    continue;
+                                // Only the thread that sets the visited bit owns the vertex
+                                if (visited[v / BITS].fetch_or(mask, memory_order_relaxed) & mask)
+                                    continue;
+                                next[v / BITS].fetch_or(mask, memory_order_relaxed);
+                                hops[v] = level + 1;
+                                found[part]++;
+                                foundEdges[part] += outStart[v + 1] - outStart[v];
+                            }
+                        }
+                });
+            }
+
+            long long previous = frontierSize;
+            frontierSize = frontierEdges = 0;
+            for (int part = 0; part < threads; part++){
+                frontierSize += found[part];
+                frontierEdges += foundEdges[part];
+            }
+            unexplored -= frontierEdges;
+            growing = frontierSize >= previous;
+            frontier.swap(next);
+        }
+        return hops;
+    }
+
+    /**
+     * Method that prints the path with the fewest edges in the format of dijkstra,
+     * going back from the target through the in-neighbour of least index one hop closer
+     * @param graph Graph the snapshot was taken from
+     * @param from Index of vertex
+     * @param to Index of vertex
+     * @param W Bandwidth
+     */
+    template<typename V>
+    void path(AdjacencyMatrixGraph<V, E>& graph, int from, int to, E W){
+        vector<int> hops = search(from, W);
+        if (from == to || hops[to] == -1){
+            cout << "IMPOSSIBLE" << endl;
+            return;
+        }
+
+        vector<int> parent(n, -1);
+        E length = 0;
+        for (int v = to; v != from; v = parent[v]){
+            for (int i = inStart[v]; i < inStart[v + 1]; i++)
+                if (inBandwidth[i] >= W && hops[inSource[i]] == hops[v] - 1){
+                    parent[v] = inSource[i];
+                    break;
+                }
+            length += graph.edges[parent[v]][v]->weight;
+        }
+        graph.printPath(parent, to, length);
+    }
+
+    /**
+     * Method that prints the vertices reachable from a vertex
+     * @param graph Graph the snapshot was taken from
+     * @param from Index of vertex
+     * @param W Bandwidth
+     */
+    template<typename V>
+    void reachable(AdjacencyMatrixGraph<V, E>& graph, int from, E W){
+        vector<int> hops = search(from, W);
+        vector<int> titles;
+        int depth = 0;
+        for (int v = 0; v < n; v++)
+            if (hops[v] != -1){
+                titles.push_back(graph.vertices[v]->title);
+                depth = max(depth, hops[v]);
+            }
+        sort(titles.begin(), titles.end());
+
+        cout << titles.size() << " " << depth << endl;
+        for (int title : titles)
+            cout << title + 1 << " ";
+        cout << endl;
+    }
+};
+
+/**
+ * Class MultiSourceSearch
+ * Distances from many sources at once over a snapshot of the edges. Sources
+ * are searched in batches of up to 512, every vertex keeping one bit per
+ * source of the batch, so a vertex reached by several sources in the same
+ * round scans its edges once for all of them. Hop counts come from a
+ * multi-source breadth-first search; lengths that are small non-negative
+ * integers from a multi-source Dial's search, whose buckets hold the sources
+ * that reach a vertex at that distance. Other lengths are searched one source
+ * at a time
+ * @tparam E Type of the weight
+ */
+template<typename E>
+class MultiSourceSearch{
+public:
+    static constexpr int BATCH = 512;       // Most sources searched together
+    static const int WEIGHT_LIMIT = 1024;   // Longest edge of the batched Dial's search
+
+    int version = -1;                       // Version of the graph the snapshot was taken from
+    E tier = 0;                             // Bandwidth of the snapshot
+    long long scans = 0;                    // Edges scanned by the last table
+
+private:
+    int n = 0;
+    vector<int> start, target;              // Edges of bandwidth at least the tier by source
+    vector<E> weight;
+    E longest = 0;                          // Longest edge of the snapshot
+    bool negative = false;                  // Whether an edge of the snapshot has a negative length
+
+    /**
+     * Bits of the sources of a batch
+     */
+    template<int WORDS>
+    struct Mask{
+        uint64_t word[WORDS] = {};
+
+        bool empty() const{
+            uint64_t any = 0;
+            for (int i = 0; i < WORDS; i++)
+                any |= word[i];
+            return any == 0;
+        }
+
+        void operator|=(const Mask& other){
+            for (int i = 0; i < WORDS; i++)
+                word[i] |= other.word[i];
+        }
+
+        /**
+         * Method that keeps the bits not in another mask
+         */
+        void remove(const Mask& other){
+            for (int i = 0; i < WORDS; i++)
+                word[i] &= ~other.word[i];
+        }
+
+        template<typename Visit>
+        void forEach(Visit visit) const{
+            for (int i = 0; i < WORDS; i++)
+                for (uint64_t bits = word[i]; bits; bits &= bits - 1)
+                    visit(i * 64 + __builtin_ctzll(bits));
+        }
+    };
+
+    /**
+     * Method that counts hops from a batch of sources, level by level
+     * @param sources Indices of the sources of the batch
+     * @param table Rows of the batch, filled with the hop counts and -1 where unreachable
+     */
+    template<int WORDS>
+    void hopBatch(const int* sources, int count, vector<int>* table){
+        typedef Mask<WORDS> Bits;
+        vector<Bits> seen(n), visit(n), next(n);
+        for (int i = 0; i < count; i++){
+            table[i].assign(n, -1);
+            table[i][sources[i]] = 0;
+            seen[sources[i]].word[i / 64] |= 1ULL << (i % 64);
+            visit[sources[i]].word[i / 64] |= 1ULL << (i % 64);
+        }
+
+        for (int level = 1, active = 1; active; level++){
+            for (int u = 0; u < n; u++){
+                if (visit[u].empty()) continue;
+                for (int e = start[u]; e < start[u + 1]; e++)
+                    next[target[e]] |= visit[u];
+                scans += start[u + 1] - start[u];
+            }
+            active = 0;
+            for (int v = 0; v < n; v++){
+                Bits reached = next[v];
+                reached.remove(seen[v]);
+                next[v] = Bits();
+                visit[v] = reached;
+                if (reached.empty()) continue;
+                seen[v] |= reached;
+                reached.forEach([&](int i){ table[i][v] = level; });
+                active = 1;
+            }
+        }
+    }
+
+    /**
+     * Method that finds the distances from a batch of sources, settling
+     * the sources that reach a vertex at every distance together
+     * @param sources Indices of the sources of the batch
+     * @param table Rows of the batch, filled with the distances and infinity where unreachable
+     */
+    template<int WORDS>
+    void dialBatch(const int* sources, int count, vector<E>* table){
+        typedef Mask<WORDS> Bits;
+        int ring = longest + 1;
+        vector< vector< pair<int, Bits> > > buckets(ring);   // Vertices with the sources reaching them at a distance
+        vector<Bits> settled(n), gathered(n);
+        vector<int> touched;
+        long long waiting = 0;
+
+        for (int i = 0; i < count; i++){
+            table[i].assign(n, WeightTraits<E>::infinity());
+            Bits source;
+            source.word[i / 64] |= 1ULL << (i % 64);
+            buckets[0].push_back({sources[i], source});
+            waiting++;
+        }
+
+        for (long long distance = 0; waiting > 0; distance++){
+            auto& bucket = buckets[distance % ring];
+
+            // Edges of length zero add to the bucket being settled, so it is drained until empty
+            while (!bucket.empty()){
+                vector< pair<int, Bits> > entries;
+                entries.swap(bucket);
+                waiting -= entries.size();
+                for (auto& entry : entries){
+                    if (gathered[entry.first].empty())
+                        touched.push_back(entry.first);
+                    gathered[entry.first] |= entry.second;
+                }
+
+                for (int u : touched){
+                    Bits reached = gathered[u];
+                    gathered[u] = Bits();
+                    reached.remove(settled[u]);
+                    if (reached.empty()) continue;
+                    settled[u] |= reached;
+                    reached.forEach([&](int i){ table[i][u] = distance; });
+                    for (int e = start[u]; e < start[u + 1]; e++){
+                        Bits onward = reached;
+                        onward.remove(settled[target[e]]);
+                        if (onward.empty()) continue;
+                        buckets[(distance + weight[e]) % ring].push_back({target[e], onward});
+                        waiting++;
+                    }
+                    scans += start[u + 1] - start[u];
+                }
+                touched.clear();
+            }
+        }
+    }
+
+    template<typename Row, typename Batch>
+    void batches(const vector<int>& sources, vector<Row>& table, Batch batch){
+        table.resize(sources.size());
+        for (int begin = 0; begin < sources.size(); begin += BATCH){
+            int count = min<int>(BATCH, sources.size() - begin);
+            batch(&sources[begin], count, &table[begin]);
+        }
+    }
+
+public:
+    /**
+     * Method that takes the snapshot of the edges whose bandwidth is at least W
+     * @param graph Graph
+     * @param W Bandwidth
+     */
+    template<typename V>
+    void build(AdjacencyMatrixGraph<V, E>& graph, E W){
+        n = graph.vertices.size();
+        version = graph.version;
+        tier = W;
+        start.assign(n + 1, 0);
+        target.clear();
+        weight.clear();
+        longest = 0;
+        negative = false;
+        for (int u = 0; u < n; u++){
+            for (auto neighbour : graph.outNeighbours(u))
+                if (neighbour.second->bandwidth >= W){
+                    target.push_back(neighbour.first);
+                    weight.push_back(neighbour.second->weight);
+                    longest = max(longest, neighbour.second->weight);
+                    negative |= neighbour.second->weight < 0;
+                }
+            start[u + 1] = target.size();
+        }
+    }
+
+    /**
+     * Method that counts the fewest edges from every source to every vertex
+     * @param sources Indices of the sources
+     * @param table Row of every source, -1 where a vertex is unreachable
+     */
+    void hops(const vector<int>& sources, vector< vector<int> >& table){
+        scans = 0;
+        batches(sources, table, [&](const int* batch, int count, vector<int>* rows){
+            if (count <= 64)
+                hopBatch<1>(batch, count, rows);
+            else
+                hopBatch<BATCH / 64>(batch, count, rows);
+        });
+    }
+
+    /**
+     * Method that finds the length of the shortest path from every source to every vertex
+     * @param sources Indices of the sources
+     * @param table Row of every source, infinity where a vertex is unreachable
+     * @return Whether the sources were searched in batches
+     */
+    bool distances(const vector<int>& sources, vector< vector<E> >& table){
+        scans = 0;
+        if constexpr (WeightTraits<E>::integral){
+            if (!negative && longest <= WEIGHT_LIMIT){
+                batches(sources, table, [&](const int* batch, int count, vector<E>* rows){
+                    if (count <= 64)
+                        dialBatch<1>(batch, count, rows);
+                    else
+                        dialBatch<BATCH / 64>(batch, count, rows);
+                });
+                return true;
+            }
+        }
+
+        // One source at a time, each with the priority queue dijkstra would choose
+        table.resize(sources.size());
+        for (int i = 0; i < sources.size(); i++)
+            single(sources[i], table[i]);
+        return false;
+    }
+
+private:
+    /**
+     * Method that finds the distances from one source with a 4-ary heap
+     * @param from Index of the source
+     * @param distance Distance to every vertex, infinity where unreachable
+     */
+    void single(int from, vector<E>& distance){
+        DaryHeap<E, 4> queue;
+        vector<bool> done(n, false);
+        distance.assign(n, WeightTraits<E>::infinity());
+        distance[from] = 0;
+        queue.push(0, from);
+        while (!queue.empty()){
+            int u = queue.pop().second;
+            if (done[u]) continue;
+            done[u] = true;
+            for (int e = start[u]; e < start[u + 1]; e++){
+                int v = target[e];
+                if (distance[u] + weight[e] < distance[v]){
+                    distance[v] = distance[u] + weight[e];
+                    if (!done[v])
+                        queue.push(distance[v], v);
+                }
+            }
+            scans += start[u + 1] - start[u];
+        }
+    }
+};
+
+/**
+ * Class ExternalGraph
+ * Semi-external copy of a graph too large for the adjacency matrix. Only the
+ * state of the vertices is held in memory; the arcs lie in a file row after
+ * row, sorted by target, and are read through a memory mapping, front to back
+ * wherever the algorithm allows it
+ * @tparam E Type of the weight
+ */
+template<typename E>
+class ExternalGraph{
+public:
+    /**
+     * Arc as stored in the file
+     */
+    struct Arc{
+        int to;
+        E weight;
+        E bandwidth;
+    };
+
+    /**
+     * Header of the file, followed by the offsets of the rows and by the arcs
+     */
+    struct Header{
+        char magic[8];
+        uint32_t weightSize;            // Size of E the file was written with
+        uint32_t reserved;
+        uint64_t vertices;
+        uint64_t arcs;
+    };
+
+    long long arcsRead = 0;             // Arcs read since the file was mapped
+    long long rowsRead = 0;             // Rows read since the file was mapped
+
+private:
+    static constexpr char MAGIC[8] = {'G', 'A', 'D', 'T', 'C', 'S', 'R', '1'};
+
+    int n = 0;
+    vector<uint64_t> offsets;           // First arc of every row, held in memory
+    const Arc* arcs = nullptr;          // Mapped arcs
+    void* mapping = MAP_FAILED;
+    size_t mappedBytes = 0;
+    long majorFaults = 0;               // Page faults before the file was mapped
+    long minorFaults = 0;
+
+    static E infinity(){
+        return numeric_limits<E>::max();
+    }
+
+    /**
+     * Method that writes the header and the offsets of a file
+     * @param file Output stream
+     * @param offsets First arc of every row and the number of arcs
+     */
+    static void writeHead(ostream& file, const vector<uint64_t>& offsets){
+        Header header = {};
+        memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.weightSize = sizeof(E);
+        header.vertices = offsets.size() - 1;
+        header.arcs = offsets.back();
+        file.write((char*) &header, sizeof(header));
+        file.write((char*) offsets.data(), offsets.size() * sizeof(uint64_t));
+    }
+
+    /**
+     * Method that hints the kernel how the mapping is about to be read
+     * @param advice MADV_SEQUENTIAL or MADV_RANDOM
+     */
+    void advise(int advice){
+        if (mapping != MAP_FAILED)
+            madvise(mapping, mappedBytes, advice);
+    }
+
+    const Arc* rowBegin(int v){
+        rowsRead++;
+        arcsRead += offsets[v + 1] - offsets[v];
+        return arcs + offsets[v];
+    }
+
+    const Arc* rowEnd(int v){
+        return arcs + offsets[v + 1];
+    }
+
+public:
+    ExternalGraph() = default;
+    ExternalGraph(const ExternalGraph&) = delete;
+    ExternalGraph& operator=(const ExternalGraph&) = delete;
+
+    ~ExternalGraph(){
+        close();
+    }
+
+    int size(){
+        return n;
+    }
+
+    bool isOpen(){
+        return mapping != MAP_FAILED;
+    }
+
+    /**
+     * Method that writes a graph as a file, numbering the vertices by their titles
+     * @param graph Graph
+     * @param path Path of the file
+     * @return Whether the file was written
+     */
+    template<typename V>
+    static bool spill(AdjacencyMatrixGraph<V, E>& graph, const string& path){
+        static_assert(is_trivially_copyable<E>::value, "weights must be trivially copyable");
+        int count = graph.vertices.size();
+        vector<int> index(count);
+        for (int i = 0; i < count; i++)
+            index[graph.vertices[i]->title] = i;
+
+        vector<uint64_t> offsets(count + 1, 0);
+        for (int title = 0; title < count; title++){
+            offsets[title + 1] = offsets[title];
+            for (auto edge : graph.edges[index[title]])
+                offsets[title + 1] += !edge->isEmpty;
+        }
+
+        ofstream file(path, ios::binary | ios::trunc);
+        writeHead(file, offsets);
+        vector<Arc> row;
+        for (int title = 0; title < count; title++){
+            row.clear();
+            for (auto neighbour : graph.outNeighbours(index[title]))
+                row.push_back({graph.vertices[neighbour.first]->title, neighbour.second->weight, neighbour.second->bandwidth});
+            sort(row.begin(), row.end(), [](const Arc& a, const Arc& b){ return a.to < b.to; });
+            file.write((char*) row.data(), row.size() * sizeof(Arc));
+        }
+        return (bool) file;
+    }
+
+    /**
+     * Method that writes a graph given as text, N M and then M lines of from to
+     * weight bandwidth numbered from 1, as a file. The rows are gathered in as
+     * many passes over the text as the budget requires, so memory holds the
+     * vertices and at most budget bytes of arcs
+     * @param input Path of the text
+     * @param path Path of the file
+     * @param budget Bytes of arcs gathered per pass
+     * @return Whether the file was written
+     */
+    static bool convert(const string& input, const string& path, size_t budget){
+        ifstream text(input);
+        long long count = 0, edges = 0;
+        if (!(text >> count >> edges) || count <= 0 || count > INT_MAX || edges < 0)
+            return false;
+        streampos start = text.tellg();
+
+        vector<uint64_t> offsets(count + 1, 0);
+        long long from, to, weight, bandwidth;
+        for (long long i = 0; i < edges; i++){
+            if (!(text >> from >> to >> weight >> bandwidth) || from < 1 || from > count || to < 1 || to > count)
+                return false;
+            offsets[from]++;
+        }
+        for (long long v = 0; v < count; v++)
+            offsets[v + 1] += offsets[v];
+
+        ofstream file(path, ios::binary | ios::trunc);
+        writeHead(file, offsets);
+        vector<Arc> buffer;
+        vector<uint64_t> filled;
+        size_t perPass = max<size_t>(budget / sizeof(Arc), 1);
+        for (long long low = 0; low < count;){
+            // The widest range of rows whose arcs fit the budget, at least one row
+            long long high = low + 1;
+            while (high < count && offsets[high + 1] - offsets[low] <= perPass)
+                high++;
+            buffer.resize(offsets[high] - offsets[low]);
+            filled.assign(high - low, 0);
+
+            text.clear();
+            text.seekg(start);
+            for (long long i = 0; i < edges && text >> from >> to >> weight >> bandwidth; i++){
+                if (from - 1 < low || from - 1 >= high) continue;
+                uint64_t slot = offsets[from - 1] - offsets[low] + filled[from - 1 - low]++;
+                buffer[slot] = {(int) (to - 1), (E) weight, (E) bandwidth};
+            }
+            for (long long v = low; v < high; v++)
+                stable_sort(buffer.begin() + (offsets[v] - offsets[low]), buffer.begin() + (offsets[v + 1] - offsets[low]),
+                            [](const Arc& a, const Arc& b){ return a.to < b.to; });
+            file.write((char*) buffer.data(), buffer.size() * sizeof(Arc));
+            low = high;
+        }
+        return (bool) file;
+    }
+
+    /**
+     * Method that maps a file written by spill or convert
+     * @param path Path of the file
+     * @return Whether the file is mapped
+     */
+    bool open(const string& path){
+        close();
+        int descriptor = ::open(path.c_str(), O_RDONLY);
+        if (descriptor == -1) return false;
+        struct stat status;
+        if (fstat(descriptor, &status) == 0 && status.st_size >= (off_t) sizeof(Header)){
+            mappedBytes = status.st_size;
+            mapping = mmap(nullptr, mappedBytes, PROT_READ, MAP_SHARED, descriptor, 0);
+        }
+        ::close(descriptor);
+        if (mapping == MAP_FAILED) return false;
+
+        const Header* header = (const Header*) mapping;
+        if (memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || header->weightSize != sizeof(E) ||
+            header->vertices > INT_MAX || header->arcs > mappedBytes / sizeof(Arc) ||
+            sizeof(Header) + (header->vertices + 1) * sizeof(uint64_t) + header->arcs * sizeof(Arc) != mappedBytes){
+            close();
+            return false;
+        }
+
+        n = header->vertices;
+        const uint64_t* rows = (const uint64_t*) (header + 1);
+        offsets.assign(rows, rows + n + 1);
+        arcs = (const Arc*) (rows + n + 1);
+
+        // A truncated or corrupt file must not lead the searches outside the mapping or the vertices
+        bool valid = offsets[0] == 0 && offsets[n] == header->arcs;
+        for (int v = 0; v < n && valid; v++)
+            valid = offsets[v] <= offsets[v + 1];
+        advise(MADV_SEQUENTIAL);
+        for (uint64_t i = 0; i < header->arcs && valid; i++)
+            valid = arcs[i].to >= 0 && arcs[i].to < n;
+        if (!valid){
+            close();
+            return false;
+        }
+        advise(MADV_DONTNEED);      // The check leaves nothing resident, as if the file had just been mapped
+        arcsRead = rowsRead = 0;
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        majorFaults = usage.ru_majflt;
+        minorFaults = usage.ru_minflt;
+        return true;
+    }
+
+    void close(){
+        if (mapping != MAP_FAILED)
+            munmap(mapping, mappedBytes);
+        mapping = MAP_FAILED;
+        mappedBytes = 0;
+        arcs = nullptr;
+        offsets.clear();
+        n = 0;
+    }
+
+    /**
+     * Method that finds a cycle with a depth-first search whose colours and
+     * path are held in memory while the rows are read from the mapping
+     * @param W Bandwidth
+     * @return Vertices of the first cycle found, in order, empty if acyclic
+     */
+    vector<int> findCycle(E W){
+        enum Colour : uint8_t {WHITE, GREY, BLACK};
+        advise(MADV_RANDOM);
+        vector<uint8_t> colour(n, WHITE);
+        vector< pair<int, const Arc*> > path;       // Vertex and its next arc
+        for (int root = 0; root < n; root++){
+            if (colour[root] != WHITE) continue;
+            colour[root] = GREY;
+            path.push_back({root, rowBegin(root)});
+            while (!path.empty()){
+                int v = path.back().first;
+                const Arc*& arc = path.back().second;
+                while (arc != rowEnd(v) && (arc->bandwidth < W || colour[arc->to] == BLACK))
+                    arc++;
+                if (arc == rowEnd(v)){
+                    colour[v] = BLACK;
+                    path.pop_back();
+                    continue;
+                }
+
+                int w = (arc++)->to;
+                if (colour[w] == GREY){
+                    vector<int> cycle;
+                    for (size_t i = 0; i < path.size(); i++)
+                        if (path[i].first == w || !cycle.empty())
+                            cycle.push_back(path[i].first);
+                    return cycle;
+                }
+                colour[w] = GREY;
+                path.push_back({w, rowBegin(w)});
+            }
+        }
+        return {};
+    }
+
+    /**
+     * Method that finds the shortest paths by sweeping over the rows in file
+     * order, relaxing the rows of the vertices improved since their last
+     * sweep; improvements to later rows are used in the same sweep
+     * @param from Index of vertex
+     * @param W Bandwidth
+     * @param distance Length of the shortest path to every vertex, infinity where unreachable
+     * @param parent Previous vertex on the shortest path
+     * @param through Bandwidth of the last arc of the shortest path
+     * @return Number of sweeps, -1 if a negative cycle is reachable
+     */
+    int sweep(int from, E W, vector<E>& distance, vector<int>& parent, vector<E>& through){
+        advise(MADV_SEQUENTIAL);
+        distance.assign(n, infinity());
+        parent.assign(n, -1);
+        through.assign(n, infinity());
+        vector<bool> active(n, false);
+        distance[from] = 0;
+        active[from] = true;
+
+        bool pending = true;
+        int sweeps = 0;
+        while (pending){
+            if (sweeps++ > n)
+                return -1;
+            pending = false;
+            for (int u = 0; u < n; u++){
+                if (!active[u]) continue;
+                active[u] = false;
+                for (const Arc* arc = rowBegin(u); arc != rowEnd(u); arc++){
+                    if (arc->bandwidth < W || !(distance[u] + arc->weight < distance[arc->to])) continue;
+                    distance[arc->to] = distance[u] + arc->weight;
+                    parent[arc->to] = u;
+                    through[arc->to] = arc->bandwidth;
+                    active[arc->to] = true;
+                    pending |= arc->to <= u;
+                }
+            }
+        }
+        return sweeps;
+    }
+
+    /**
+     * Method that finds the shortest paths with dijkstra, reading the row of
+     * every settled vertex wherever it lies
+     * @param from Index of vertex
+     * @param W Bandwidth
+     * @param distance Length of the shortest path to every vertex, infinity where unreachable
+     * @param parent Previous vertex on the shortest path
+     * @param through Bandwidth of the last arc of the shortest path
+     */
+    void dijkstra(int from, E W, vector<E>& distance, vector<int>& parent, vector<E>& through){
+        advise(MADV_RANDOM);
+        distance.assign(n, infinity());
+        parent.assign(n, -1);
+        through.assign(n, infinity());
+        vector<bool> settled(n, false);
+        DaryHeap<E, 4> queue;
+        distance[from] = 0;
+        queue.push(0, from);
+        while (!queue.empty()){
+            int u = queue.pop().second;
+            if (settled[u]) continue;
+            settled[u] = true;
+            for (const Arc* arc = rowBegin(u); arc != rowEnd(u); arc++){
+                if (arc->bandwidth < W || !(distance[u] + arc->weight < distance[arc->to])) continue;
+                distance[arc->to] = distance[u] + arc->weight;
+                parent[arc->to] = u;
+                through[arc->to] = arc->bandwidth;
+                queue.push(distance[arc->to], arc->to);
+            }
+        }
+    }
+
+    /**
+     * Method that prints the shortest path in the format of dijkstra
+     * @param from Index of vertex
+     * @param to Index of vertex
+     * @param W Bandwidth
+     */
+    void route(int from, int to, E W){
+        vector<E> distance, through;
+        vector<int> parent;
+        if (from == to || sweep(from, W, distance, parent, through) == -1 || distance[to] == infinity()){
+            cout << "IMPOSSIBLE" << endl;
+            return;
+        }
+
+        vector<int> path;
+        E bandwidth = infinity();
+        for (int v = to; v != from; v = parent[v]){
+            path.push_back(v);
+            bandwidth = min(bandwidth, through[v]);
+        }
+        path.push_back(from);
+        cout << path.size() << " " << distance[to] << " " << bandwidth << endl;
+        for (int i = path.size() - 1; i >= 0; i--)
+            cout << path[i] + 1 << " ";
+        cout << endl;
+    }
+
+    /**
+     * Method that prints the counters of the mapping
+     */
+    void stats(){
+        size_t page = sysconf(_SC_PAGESIZE);
+        size_t resident = 0;
+        if (isOpen()){
+            vector<unsigned char> pages((mappedBytes + page - 1) / page);
+            if (mincore(mapping, mappedBytes, pages.data()) == 0)
+                for (unsigned char p : pages)
+                    resident += (p & 1) * page;
+        }
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        cout << "mapped_bytes " << mappedBytes << " resident_bytes " << resident << " rows_read " << rowsRead
+             << " arcs_read " << arcsRead << " major_faults " << usage.ru_majflt - majorFaults
+             << " minor_faults " << usage.ru_minflt - minorFaults << endl;
+    }
+};
+
+/**
+ * Class CacheMissCounter
+ * Hardware counter of the cache misses of the process, where the kernel allows it
+ */
+class CacheMissCounter{
+    int descriptor = -1;
+
+public:
+    CacheMissCounter(){
+        perf_event_attr attributes = {};
+        attributes.type = PERF_TYPE_HARDWARE;
+        attributes.size = sizeof(attributes);
+        attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+        attributes.disabled = 1;
+        attributes.exclude_kernel = 1;
+        attributes.exclude_hv = 1;
+        descriptor = syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0);
+    }
+
+    CacheMissCounter(const CacheMissCounter&) = delete;
+    CacheMissCounter& operator=(const CacheMissCounter&) = delete;
+
+    ~CacheMissCounter(){
+        if (descriptor != -1)
+            close(descriptor);
+    }
+
+    void start(){
+        if (descriptor == -1) return;
+        ioctl(descriptor, PERF_EVENT_IOC_RESET, 0);
+        ioctl(descriptor, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    /**
+     * Method that stops counting
+     * @return Cache misses since start, -1 if the counter is unavailable
+     */
+    long long stop(){
+        long long count = -1;
+        if (descriptor == -1) return count;
+        ioctl(descriptor, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(descriptor, &count, sizeof(count)) != sizeof(count))
+            count = -1;
+        return count;
+    }
+};
+
+/**
+ * Method that solves current problem
  */
 void solve(){
     typedef int V;
@@ -442,8 +4053,555 @@ void solve(){
         auto toVertex = new Vertex<V>(to - 1);
         graph.addEdge(fromVertex, toVertex, weight, bandwidth);
     }
+    vector<int> internal(N);        // Index of the vertex of every input number, changed by REORDER
+    for (int i = 0; i < N; i++)
+        internal[i] = i;
+    auto at = [&](int number){
+        return internal[number - 1];
+    };
+
     cin >> from >> to >> W;
-    graph.dijkstra(from - 1, to - 1, W);
+    graph.shortestPath(at(from), at(to), W);
+
+    map<E, ContractionHierarchy<E>> hierarchies;    // Contraction hierarchies by bandwidth tier
+    map<pair<int, E>, ShortestPathTree<E>> trees;   // Maintained trees by root and bandwidth tier
+    auto maintained = [&](int root, E tier) -> ShortestPathTree<E>& {
+        auto tree = trees.find({root, tier});
+        if (tree == trees.end()){
+            tree = trees.emplace(make_pair(root, tier), ShortestPathTree<E>()).first;
+            tree->second.build(graph, root, tier);
+        }
+        return tree->second;
+    };
+    // Renumbers the vertices for locality, indices kept by other structures become stale
+    auto renumber = [&](const string& method){
+        graph.reorder(graph.localityOrder(method));
+        for (int i = 0; i < graph.vertices.size(); i++)
+            internal[graph.vertices[i]->title] = i;
+        hierarchies.clear();
+        trees.clear();
+    };
+    CompressedGraph<E> frozen;                      // Compressed read-only copy of the graph
+    frozen.window = 7;
+    auto compressed = [&]() -> CompressedGraph<E>& {
+        if (frozen.version != graph.version)
+            frozen.build(graph, frozen.window);
+        return frozen;
+    };
+    FrontierSearch<E> levels;                       // Snapshot for unweighted searches
+    auto levelled = [&]() -> FrontierSearch<E>& {
+        if (levels.version != graph.version)
+            levels.build(graph);
+        return levels;
+    };
+    PartitionedGraph<E> partitioned;                // Shards of the graph in worker processes
+    int partitions = max(1, (int) sysconf(_SC_NPROCESSORS_ONLN));
+    auto sharded = [&]() -> PartitionedGraph<E>& {
+        if (partitioned.workers != partitions || partitioned.version != graph.version)
+            partitioned.start(graph, partitions);
+        return partitioned;
+    };
+
+    // Path queries, counted by the profile under EXPLAIN
+    auto pathQuery = [&](const string& query, auto& profile){
+        if (query == "SHORTEST"){
+            cin >> from >> to >> W;
+            graph.shortestPath(at(from), at(to), W, profile);
+        }
+        else if (query == "LONGEST"){
+            cin >> from >> to >> W;
+            graph.longestPath(at(from), at(to), W, profile);
+        }
+        else{
+            cin >> W;
+            graph.criticalPath(W, profile);
+        }
+    };
+    ExternalGraph<E> external;                      // Mapped graph kept on disk
+    KShortestPaths<E> ranking;                      // Arrays of the spur searches, kept between queries
+    MultiSourceSearch<E> batched;                   // Snapshot for distance tables
+    auto tabled = [&](E tier) -> MultiSourceSearch<E>& {
+        if (batched.version != graph.version || batched.tier != tier)
+            batched.build(graph, tier);
+        return batched;
+    };
+    // Sources and targets of a table, as counts followed by input numbers
+    auto readTable = [&](vector<int>& sources, vector<int>& targets){
+        for (auto list : {&sources, &targets}){
+            int count;
+            cin >> count;
+            list->resize(count);
+            for (int& vertex : *list){
+                cin >> vertex;
+                vertex = at(vertex);
+            }
+        }
+    };
+    string tracePath;                               // Chrome trace of the explained queries, empty for none
+    vector<string> traceEvents;
+
+    string cmd;
+    while (cin >> cmd){
+        // Commands under EXPLAIN other than the path queries are only timed
+        string explained;
+        QueryProfile timing;
+        bool timed = false;
+        while (cmd == "EXPLAIN" && cin >> explained && explained != "SHORTEST" && explained != "LONGEST"
+               && explained != "CRITICAL_PATH"){
+            if (!timed)
+                timing.phase("query");
+            timed = true;
+            cmd = explained;
+        }
+
+        if (cmd == "CH_BUILD"){
+            cin >> W;
+            hierarchies[W].build(graph, W);
+        }
+        else if (cmd == "ROUTE"){
+            cin >> from >> to >> W;
+            auto tier = hierarchies.find(W);
+            if (tier == hierarchies.end()){
+                tier = hierarchies.emplace(W, ContractionHierarchy<E>()).first;
+                tier->second.build(graph, W);
+            }
+            tier->second.route(graph, at(from), at(to));
+        }
+        else if (cmd == "CH_SAVE"){
+            string path;
+            cin >> path;
+            ofstream file(path, ios::binary);
+            int count = hierarchies.size();
+            file.write((char*) &count, sizeof(count));
+            for (auto& tier : hierarchies)
+                tier.second.save(file);
+        }
+        else if (cmd == "CH_LOAD"){
+            string path;
+            cin >> path;
+            ifstream file(path, ios::binary);
+            int count = 0;
+            file.read((char*) &count, sizeof(count));
+            auto signature = ContractionHierarchy<E>::fingerprint(graph);
+            for (int i = 0; i < count && file; i++){
+                ContractionHierarchy<E> hierarchy;
+                // An index built from a different topology is ignored and rebuilt on demand; after
+                // one that cannot be read the position in the file is lost, so the rest is ignored too
+                if (!hierarchy.load(file, signature, graph.vertices.size()))
+                    break;
+                hierarchies[hierarchy.tier] = hierarchy;
+            }
+        }
+        else if (cmd == "ADD_EDGE" || cmd == "REMOVE_EDGE"){
+            cin >> from >> to;
+            if (cmd == "ADD_EDGE"){
+                cin >> weight >> bandwidth;
+                auto fromVertex = new Vertex<V>(from - 1);
+                auto toVertex = new Vertex<V>(to - 1);
+                graph.addEdge(fromVertex, toVertex, weight, bandwidth);
+            }
+            else{
+                graph.removeEdge(graph.findEdge(from - 1, to - 1));
+            }
+
+            // Hierarchies assume a static topology, maintained trees are repaired in place
+            hierarchies.clear();
+            for (auto& tree : trees)
+                tree.second.update(graph, at(from), at(to));
+        }
+        else if (cmd == "SHORTEST" || cmd == "LONGEST" || cmd == "CRITICAL_PATH"){
+            pathQuery(cmd, noProfile);
+        }
+        else if (cmd == "EXPLAIN" && !explained.empty()){
+            QueryProfile profile;
+            pathQuery(explained, profile);
+            profile.report(cout);
+            if (!tracePath.empty()){
+                profile.trace(traceEvents, explained);
+                QueryProfile::writeTrace(tracePath, traceEvents);
+            }
+        }
+        else if (cmd == "TRACE"){
+            cin >> tracePath;
+            if (tracePath == "-")
+                tracePath.clear();
+            traceEvents.clear();
+        }
+        else if (cmd == "K_PATHS"){
+            int k;
+            cin >> from >> to >> W >> k;
+            auto paths = ranking.search(graph, at(from), at(to), W, k);
+            if (paths.empty())
+                cout << "IMPOSSIBLE" << endl;
+            for (auto& path : paths)
+                graph.printPath(path.second, path.first);
+        }
+        else if (cmd == "DISTANCE_TABLE" || cmd == "HOP_TABLE"){
+            vector<int> sources, targets;
+            cin >> W;
+            readTable(sources, targets);
+            MultiSourceSearch<E>& search = tabled(W);
+            vector< vector<E> > lengths;
+            vector< vector<int> > hops;
+            if (cmd == "DISTANCE_TABLE")
+                search.distances(sources, lengths);
+            else
+                search.hops(sources, hops);
+            for (int i = 0; i < sources.size(); i++){
+                for (int target : targets){
+                    if (cmd == "DISTANCE_TABLE" && lengths[i][target] != WeightTraits<E>::infinity())
+                        cout << lengths[i][target] << " ";
+                    else if (cmd == "HOP_TABLE" && hops[i][target] != -1)
+                        cout << hops[i][target] << " ";
+                    else
+                        cout << "INF ";
+                }
+                cout << endl;
+            }
+        }
+        else if (cmd == "TABLE_BENCH"){
+            int count;
+            cin >> W >> count;
+            vector<int> sources;
+            for (int i = 0; i < count && i < N; i++)
+                sources.push_back(at(i + 1));
+            MultiSourceSearch<E>& search = tabled(W);
+            auto report = [&](const string& name, double elapsed, long long scans, long long total){
+                cout << name << " " << elapsed << " " << scans << " " << total << endl;
+            };
+            auto sum = [](const vector< vector<E> >& table){
+                long long total = 0;
+                for (auto& row : table)
+                    for (E d : row)
+                        if (d != WeightTraits<E>::infinity())
+                            total += d;
+                return total;
+            };
+
+            cout << "search ms scans total" << endl;
+            vector< vector<E> > lengths(sources.size());
+            vector<int> parent;
+            auto start = chrono::steady_clock::now();
+            for (int i = 0; i < sources.size(); i++)
+                graph.distances(graph.vertices.size(), sources[i], W, [&](int u){ return graph.outNeighbours(u); }, lengths[i], parent);
+            report("dijkstra", chrono::duration<double, milli>(chrono::steady_clock::now() - start).count(), -1, sum(lengths));
+
+            start = chrono::steady_clock::now();
+            bool batches = search.distances(sources, lengths);
+            report(batches ? "batched" : "single", chrono::duration<double, milli>(chrono::steady_clock::now() - start).count(),
+                   search.scans, sum(lengths));
+
+            vector< vector<int> > hops;
+            start = chrono::steady_clock::now();
+            search.hops(sources, hops);
+            long long total = 0;
+            for (auto& row : hops)
+                for (int h : row)
+                    total += max(h, 0);
+            report("hops", chrono::duration<double, milli>(chrono::steady_clock::now() - start).count(), search.scans, total);
+        }
+        else if (cmd == "MAINTAIN"){
+            cin >> from >> W;
+            maintained(at(from), W);
+        }
+        else if (cmd == "DISTANCE"){
+            cin >> from >> W >> to;
+            maintained(at(from), W).printDistance(at(to));
+        }
+        else if (cmd == "TREE_PATH"){
+            cin >> from >> W >> to;
+            maintained(at(from), W).printPath(graph, at(to));
+        }
+        else if (cmd == "FREEZE"){
+            int window;
+            cin >> window;
+            frozen.build(graph, window);
+            frozen.printSize();
+        }
+        else if (cmd == "FROZEN_ROUTE"){
+            cin >> from >> to >> W;
+            compressed().route(graph, at(from), at(to), W);
+        }
+        else if (cmd == "FROZEN_BENCH"){
+            cin >> from >> W;
+            auto& copy = compressed();
+            auto elapsed = [](chrono::steady_clock::time_point start){
+                return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            };
+            vector<E> distance, through;
+            vector<int> parent;
+
+            auto start = chrono::steady_clock::now();
+            int reached = copy.traverse(at(from), W, false);
+            double bfs = elapsed(start);
+            start = chrono::steady_clock::now();
+            copy.traverse(at(from), W, true);
+            double dfs = elapsed(start);
+            start = chrono::steady_clock::now();
+            copy.dijkstra(at(from), W, distance, parent, through);
+            double shortest = elapsed(start);
+
+            copy.printSize();
+            cout << "reached " << reached << " bfs_ms " << bfs << " dfs_ms " << dfs << " dijkstra_ms " << shortest << endl;
+        }
+        else if (cmd == "REORDER"){
+            string method;
+            cin >> method;
+            renumber(method);
+        }
+        else if (cmd == "REORDER_BENCH"){
+            string method;
+            cin >> method >> from >> W;
+            CacheMissCounter counter;
+            auto measure = [&](const string& label){
+                int n = graph.vertices.size();
+                double span = 0;
+                long long edges = 0;
+                for (int i = 0; i < n; i++)
+                    for (auto neighbour : graph.outNeighbours(i)){
+                        span += abs(neighbour.first - i);
+                        edges++;
+                    }
+
+                counter.start();
+                auto start = chrono::steady_clock::now();
+                vector<bool> seen(n, false);
+                vector<int> queue(1, at(from));
+                seen[at(from)] = true;
+                for (size_t head = 0; head < queue.size(); head++)
+                    for (auto neighbour : graph.outNeighbours(queue[head]))
+                        if (neighbour.second->bandwidth >= W && !seen[neighbour.first]){
+                            seen[neighbour.first] = true;
+                            queue.push_back(neighbour.first);
+                        }
+                double bfs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+                start = chrono::steady_clock::now();
+                ShortestPathTree<E> tree;
+                tree.build(graph, at(from), W);
+                double sssp = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+                long long misses = counter.stop();
+
+                cout << label << " edge_span " << span / max(edges, 1LL) << " bfs_ms " << bfs << " sssp_ms " << sssp
+                     << " cache_misses " << misses << endl;
+            };
+
+            measure("before");
+            renumber(method);
+            measure("after");
+        }
+        else if (cmd == "BFS"){
+            cin >> from >> W;
+            levelled().reachable(graph, at(from), W);
+        }
+        else if (cmd == "HOPS"){
+            cin >> from >> to >> W;
+            levelled().path(graph, at(from), at(to), W);
+        }
+        else if (cmd == "BFS_THREADS"){
+            cin >> levels.threads;
+            levels.threads = max(1, levels.threads);
+        }
+        else if (cmd == "BFS_BENCH"){
+            cin >> from >> W;
+            FrontierSearch<E>& search = levelled();
+            const char* names[] = {"top-down", "bottom-up", "hybrid"};
+            cout << "strategy ms top_down_steps bottom_up_steps reached" << endl;
+            for (auto strategy : {FrontierSearch<E>::TOP_DOWN, FrontierSearch<E>::BOTTOM_UP, FrontierSearch<E>::HYBRID}){
+                auto start = chrono::steady_clock::now();
+                vector<int> hops = search.search(at(from), W, strategy);
+                double elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+                cout << names[strategy] << " " << elapsed << " " << search.topDownSteps << " " << search.bottomUpSteps
+                     << " " << count_if(hops.begin(), hops.end(), [](int h){ return h != -1; }) << endl;
+            }
+        }
+        else if (cmd == "SIMD"){
+            string name;
+            cin >> name;
+            graph.denseEnabled = name != "off";
+            kernelChoice = -1;
+            for (int i = 0; i < 3; i++)
+                if (name == KERNELS[i].name)
+                    kernelChoice = i;
+        }
+        else if (cmd == "DENSE_BENCH"){
+            cin >> from >> W;
+            graph.denseRows();
+            auto report = [&](const string& name, double elapsed, const vector<E>& distance){
+                int reached = 0;
+                long long total = 0;
+                for (E d : distance)
+                    if (d != WeightTraits<E>::infinity()){
+                        reached++;
+                        total += d;
+                    }
+                cout << name << " " << elapsed << " " << reached << " " << total << endl;
+            };
+
+            cout << "kernel ms reached total" << endl;
+            vector<E> distance, through;
+            vector<int> parent;
+            bool enabled = graph.denseEnabled;
+            graph.denseEnabled = true;
+            for (auto& kernels : KERNELS){
+                if (!kernels.supported()) continue;
+                auto start = chrono::steady_clock::now();
+                if (!graph.denseDistances(at(from), W, distance, parent, through, kernels)) break;
+                report(kernels.name, chrono::duration<double, milli>(chrono::steady_clock::now() - start).count(), distance);
+            }
+            graph.denseEnabled = enabled;
+            auto start = chrono::steady_clock::now();
+            graph.distances(graph.vertices.size(), at(from), W, [&](int u){ return graph.outNeighbours(u); }, distance, parent);
+            report("queue", chrono::duration<double, milli>(chrono::steady_clock::now() - start).count(), distance);
+        }
+        else if (cmd == "QUEUE_BENCH"){
+            cin >> from >> W;
+            typedef AdjacencyMatrixGraph<V, E> Graph;
+            int n = graph.vertices.size();
+            vector< vector< pair<int, Edge<E>*> > > lists(n);
+            for (int u = 0; u < n; u++)
+                for (auto neighbour : graph.outNeighbours(u))
+                    lists[u].push_back(neighbour);
+            auto rows = [&](int u) -> const vector< pair<int, Edge<E>*> >& {
+                return lists[u];
+            };
+
+            const char* names[] = {"automatic", "binary", "4-ary", "buckets", "radix"};
+            cout << "queue ms reached total" << endl;
+            for (auto kind : {Graph::BINARY, Graph::DARY, Graph::BUCKETS, Graph::RADIX, Graph::AUTOMATIC}){
+                vector<E> distance;
+                vector<int> parent;
+                auto start = chrono::steady_clock::now();
+                auto used = Graph::distances(n, at(from), W, rows, distance, parent, kind);
+                double elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+                int reached = 0;
+                long long total = 0;
+                for (E d : distance)
+                    if (d != WeightTraits<E>::infinity()){
+                        reached++;
+                        total += d;
+                    }
+                cout << names[used] << " " << elapsed << " " << reached << " " << total << endl;
+            }
+        }
+        else if (cmd == "SPILL"){
+            string path;
+            cin >> path;
+            if (!ExternalGraph<E>::spill(graph, path))
+                cerr << "cannot write " << path << endl;
+        }
+        else if (cmd == "CONVERT"){
+            string input, path;
+            long long megabytes;
+            cin >> input >> path >> megabytes;
+            if (!ExternalGraph<E>::convert(input, path, max(megabytes, 1LL) << 20))
+                cerr << "cannot convert " << input << endl;
+        }
+        else if (cmd == "MAP"){
+            string path;
+            cin >> path;
+            if (!external.open(path))
+                cerr << "cannot map " << path << endl;
+        }
+        else if (cmd == "EXTERNAL_ROUTE"){
+            cin >> from >> to >> W;
+            if (!external.isOpen() || from < 1 || to < 1 || from > external.size() || to > external.size())
+                cout << "IMPOSSIBLE" << endl;
+            else
+                external.route(from - 1, to - 1, W);
+        }
+        else if (cmd == "EXTERNAL_CYCLE"){
+            cin >> W;
+            vector<int> cycle = external.findCycle(W);
+            if (cycle.empty())
+                cout << "ACYCLIC" << endl;
+            else{
+                cout << cycle.size() << endl;
+                for (int v : cycle)
+                    cout << v + 1 << " ";
+                cout << endl;
+            }
+        }
+        else if (cmd == "EXTERNAL_STATS"){
+            external.stats();
+        }
+        else if (cmd == "EXTERNAL_BENCH"){
+            cin >> from >> W;
+            if (external.isOpen() && from >= 1 && from <= external.size()){
+                vector<E> distance, through;
+                vector<int> parent;
+                cout << "method ms rows_read arcs_read sweeps" << endl;
+                for (int method = 0; method < 2; method++){
+                    long long rows = external.rowsRead, arcs = external.arcsRead;
+                    int sweeps = 1;
+                    auto start = chrono::steady_clock::now();
+                    if (method == 0)
+                        sweeps = external.sweep(from - 1, W, distance, parent, through);
+                    else
+                        external.dijkstra(from - 1, W, distance, parent, through);
+                    double elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+                    cout << (method == 0 ? "sweep" : "dijkstra") << " " << elapsed << " " << external.rowsRead - rows
+                         << " " << external.arcsRead - arcs << " " << sweeps << endl;
+                }
+            }
+        }
+        else if (cmd == "PARTITION"){
+            cin >> partitions;
+            partitions = max(1, partitions);
+            sharded();
+        }
+        else if (cmd == "PSHORTEST"){
+            cin >> from >> to >> W;
+            sharded().path(graph, PartitionedGraph<E>::SHORTEST, at(from), at(to), W);
+        }
+        else if (cmd == "PBFS"){
+            cin >> from >> to >> W;
+            sharded().path(graph, PartitionedGraph<E>::HOPS, at(from), at(to), W);
+        }
+        else if (cmd == "PCYCLIC"){
+            cin >> W;
+            sharded().cyclicCore(graph, W);
+        }
+        else if (cmd == "PARTITION_BENCH"){
+            int count;
+            cin >> count >> from >> W;
+            auto elapsed = [](chrono::steady_clock::time_point start){
+                return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            };
+
+            cout << "workers start_ms shortest_ms bfs_ms trim_ms supersteps messages" << endl;
+            for (int k = 1; k <= count; k++){
+                auto start = chrono::steady_clock::now();
+                partitioned.start(graph, k);
+                double started = elapsed(start);
+
+                start = chrono::steady_clock::now();
+                partitioned.run(PartitionedGraph<E>::SHORTEST, W, {{at(from), -1, 0, 0}});
+                double shortest = elapsed(start);
+                int supersteps = partitioned.supersteps;
+                long long messages = partitioned.messages;
+
+                start = chrono::steady_clock::now();
+                partitioned.run(PartitionedGraph<E>::HOPS, W, {{at(from), -1, 0, 0}});
+                double hops = elapsed(start);
+
+                start = chrono::steady_clock::now();
+                partitioned.run(PartitionedGraph<E>::TRIM, W, {});
+                double trim = elapsed(start);
+
+                cout << partitioned.workers << " " << started << " " << shortest << " " << hops << " " << trim
+                     << " " << supersteps << " " << messages << endl;
+            }
+        }
+
+        if (timed){
+            timing.report(cout);
+            if (!tracePath.empty()){
+                timing.trace(traceEvents, cmd);
+                QueryProfile::writeTrace(tracePath, traceEvents);
+            }
+        }
+    }
 
 }
 